@@ -1,92 +1,66 @@
-	pushl %eax
-	movl 2, %eax
-	movl %eax,x
-	pushl %eax
-	movl 2, %eax
-	movl %eax,y
-.L1
-	pushl %eax
-	movl y,%eax
-	pushl %eax
-	movl 1, %eax
+	movl $2, %eax
+	movl %eax,x(%rip)
+	movl $2, %eax
+	negl %eax
+	movl %eax,y(%rip)
+.L1:
+	movl y(%rip), %eax
+	pushq %rax
+	movl $1, %eax
+	negl %eax
+	popq %rcx
+	cmpl %eax, %ecx
+	setl %al
+	movzbl %al, %eax
+	testl %eax, %eax
 	jz .L2
-	pushl %eax
-	movl y,%eax
-	movl %eax,x
-	pushl %eax
-	movl x,%eax
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	addl %eax, (%esp)
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	pushl %eax
-	movl 45, %eax
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	addl %eax, (%esp)
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	movl %eax,x
-	pushl %eax
-	movl y,%eax
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	addl %eax, (%esp)
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	pushl %eax
-	movl 1, %eax
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	addl %eax, (%esp)
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	movl %eax,y
+	movl y(%rip), %eax
+	movl %eax,x(%rip)
+	movl x(%rip), %eax
+	pushq %rax
+	movl $45, %eax
+	popq %rcx
+	addl %ecx, %eax
+	movl %eax,x(%rip)
+	movl y(%rip), %eax
+	pushq %rax
+	movl $1, %eax
+	popq %rcx
+	addl %ecx, %eax
+	movl %eax,y(%rip)
 	jmp .L1
-.L2
-	pushl %eax
-	movl x,%eax
-	pushl %eax
-	movl 3, %eax
+.L2:
+	movl x(%rip), %eax
+	pushq %rax
+	movl $3, %eax
+	popq %rcx
+	cmpl %eax, %ecx
+	setg %al
+	movzbl %al, %eax
+	testl %eax, %eax
 	jz .L3
-	pushl %eax
-	movl 2, %eax
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	imull %esp, %eax
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	pushl %eax
-	movl y,%eax
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	imull %esp, %eax
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	addl %eax, (%esp)
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	pushl %eax
-	movl 4, %eax
-	movl (%rsp), %ebx
-	movl %rax, %eax
-	addl %eax, (%esp)
-	movsd %xmm0, %rax
-	addq $8,%rsp
-	movl %eax,x
-	pushl %eax
-	movl 7, %eax
-	movl %eax,y
+	movl $2, %eax
+	pushq %rax
+	movl y(%rip), %eax
+	popq %rcx
+	imull %ecx, %eax
+	pushq %rax
+	movl $4, %eax
+	popq %rcx
+	addl %ecx, %eax
+	movl %eax,x(%rip)
+	movl $7, %eax
+	movl %eax,y(%rip)
 	jmp .L4
-.L3
-.L4
-	pushl %eax
-	movl 5, %eax
-	movl %eax,y
-	pushl %eax
-	movl 4, %eax
-	movl %eax,x
-.L4
+.L3:
+	movl $5, %eax
+	movl %eax,y(%rip)
+	movl $4, %eax
+	movl %eax,x(%rip)
+.L4:
+	.bss
+	.balign 4
+x:
+	.zero 4
+y:
+	.zero 4
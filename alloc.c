@@ -0,0 +1,14 @@
+/**@<alloc.c>::**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <tokens.h>
+#include <alloc.h>
+
+void *alloc_grow(void *array, size_t count, size_t size, char const *who)
+{
+  if ((array = realloc(array, count * size)) == NULL) {
+    fprintf(stderr, "%s: FATAL ERROR %d: out of memory\n", who, ALOCATION_ERR);
+    exit(ALOCATION_ERR);
+  }
+  return array;
+}
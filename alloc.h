@@ -0,0 +1,14 @@
+/**@<alloc.h>::**/
+#ifndef _ALLOC_H_
+#define _ALLOC_H_
+
+#include <stddef.h>
+
+/*
+ * running out of memory ends the compilation: alloc_grow reallocates
+ * array to count elements of size bytes, or reports who ran out and exits
+ * with ALOCATION_ERR, so callers never see NULL
+ */
+extern void *alloc_grow(void *array, size_t count, size_t size, char const *who);
+
+#endif
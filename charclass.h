@@ -0,0 +1,25 @@
+/**@<charclass.h>::**/
+#ifndef _CHARCLASS_H_
+#define _CHARCLASS_H_
+
+/*
+ * byte classes for the lexer: a test is one load and a mask, and unlike
+ * the ctype functions the answer does not depend on the process locale.
+ * lexgen writes the table into lextab.c from the definitions below.
+ */
+#define CHAR_LETTER   0x01 // A-Z a-z
+#define CHAR_DIGIT    0x02 // 0-9
+#define CHAR_OCTAL    0x04 // 0-7
+#define CHAR_HEX      0x08 // 0-9 A-F a-f
+#define CHAR_SPACE    0x10 // space \t \n \v \f \r
+#define CHAR_OPERATOR 0x20 // first byte of an operator or punctuation token
+#define CHAR_ALNUM    (CHAR_LETTER | CHAR_DIGIT)
+
+#define CHAR_OPERATORS ":<>.=+-*/(),;[]^@"
+
+extern unsigned char const lextab_charclass[256];
+
+// charis: whether byte c is in any of the classes
+#define charis(c, classes) (lextab_charclass[(unsigned char) (c)] & (classes))
+
+#endif
@@ -0,0 +1,144 @@
+/**@<intern.c>::**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tokens.h>
+#include <intern.h>
+#include <alloc.h>
+#include <lextab.h>
+
+#define ARENA_CHUNK 0x10000
+
+/* the interner belongs to the compilation running on the calling thread */
+
+/* arena: names are NUL-terminated and packed one after the other in chunks
+that are never reallocated; a name larger than a chunk gets one of its own.
+Each chunk starts with a link to the previous one, for intern_reset. */
+static _Thread_local char *arena_next = NULL, *arena_end = NULL, *arena_chunks = NULL;
+
+static char *arena_copy(char const *name, size_t length)
+{
+  char *copy, *chunk;
+  size_t i, size = sizeof(char *) + (length + 1 > ARENA_CHUNK ? length + 1 : ARENA_CHUNK);
+
+  if (arena_next == NULL || (size_t) (arena_end - arena_next) < length + 1) {
+    chunk = alloc_grow(NULL, size, 1, "intern");
+    memcpy(chunk, &arena_chunks, sizeof(char *));
+    arena_chunks = chunk;
+    arena_next = chunk + sizeof(char *);
+    arena_end = chunk + size;
+  }
+  copy = arena_next;
+  for (i = 0; i < length; i++)
+    copy[i] = lextab_fold[(unsigned char) name[i]];
+  copy[length] = 0;
+  arena_next += length + 1;
+  return copy;
+}
+
+/* per id (index 0 unused): where the name lives, its length and hash */
+static _Thread_local char const **names = NULL;
+static _Thread_local uint32_t *lengths = NULL, *hashes = NULL;
+static _Thread_local uint32_t nnames = 0, names_capacity = 0;
+
+/* open addressing with linear probing over ids, 0 marks an empty slot */
+static _Thread_local uint32_t *slots = NULL;
+static _Thread_local uint32_t slots_mask = 0;
+
+/* names are case-insensitive: they are hashed, compared and stored folded
+to lower case, one table lookup per byte on the way */
+static uint32_t hash(char const *name, size_t length)
+{
+  uint32_t h = 2166136261u; // FNV-1a
+
+  while (length--) {
+    h ^= lextab_fold[(unsigned char) *name++];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// same: whether the stored (folded) name equals name up to case
+static int same(char const *folded, char const *name, size_t length)
+{
+  while (length--) {
+    if (*folded++ != lextab_fold[(unsigned char) *name++])
+      return 0;
+  }
+  return 1;
+}
+
+// rehash: doubles the slot table, reinserting every id with its stored hash
+static void rehash(void)
+{
+  uint32_t id, i, size = slots_mask ? 2 * (slots_mask + 1) : 0x400;
+
+  free(slots);
+  slots = alloc_grow(NULL, size, sizeof *slots, "intern");
+  memset(slots, 0, size * sizeof *slots);
+  slots_mask = size - 1;
+  for (id = 1; id <= nnames; id++) {
+    for (i = hashes[id] & slots_mask; slots[i]; i = (i + 1) & slots_mask);
+    slots[i] = id;
+  }
+}
+
+uint32_t intern(char const *name, size_t length)
+{
+  uint32_t h = hash(name, length), i, id;
+
+  if (2 * (nnames + 1) > slots_mask)
+    rehash();
+
+  for (i = h & slots_mask; (id = slots[i]); i = (i + 1) & slots_mask) {
+    if (hashes[id] == h && lengths[id] == length && same(names[id], name, length))
+      return id;
+  }
+
+  if (nnames + 1 >= names_capacity) {
+    names_capacity = names_capacity ? 2 * names_capacity : 0x400;
+    names = alloc_grow(names, names_capacity, sizeof *names, "intern");
+    lengths = alloc_grow(lengths, names_capacity, sizeof *lengths, "intern");
+    hashes = alloc_grow(hashes, names_capacity, sizeof *hashes, "intern");
+  }
+  id = ++nnames;
+  names[id] = arena_copy(name, length);
+  lengths[id] = length;
+  hashes[id] = h;
+  slots[i] = id;
+  return id;
+}
+
+char const *intern_name(uint32_t id)
+{
+  return id && id <= nnames ? names[id] : NULL;
+}
+
+size_t intern_length(uint32_t id)
+{
+  return id && id <= nnames ? lengths[id] : 0;
+}
+
+uint32_t intern_count(void)
+{
+  return nnames;
+}
+
+// intern_reset: forgets every name and releases the memory, ids start over from 1
+void intern_reset(void)
+{
+  char *chunk;
+
+  while ((chunk = arena_chunks) != NULL) {
+    memcpy(&arena_chunks, chunk, sizeof(char *));
+    free(chunk);
+  }
+  arena_next = arena_end = NULL;
+  free(names);
+  free(lengths);
+  free(hashes);
+  free(slots);
+  names = NULL;
+  lengths = hashes = slots = NULL;
+  nnames = names_capacity = slots_mask = 0;
+}
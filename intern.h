@@ -0,0 +1,22 @@
+/**@<intern.h>::**/
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * identifier interning: every distinct name is copied once into an arena
+ * and gets a dense id, 1 for the first name seen, 2 for the next and so on;
+ * 0 is never a valid id. Names never move, so intern_name pointers stay
+ * valid for the whole compilation. The pool is thread-local: each thread
+ * compiling a program has its own. Pascal names are case-insensitive, so
+ * X and x are the same name; intern_name gives it in lower case.
+ */
+extern uint32_t intern(char const *name, size_t length);
+extern char const *intern_name(uint32_t id);
+extern size_t intern_length(uint32_t id);
+extern uint32_t intern_count(void);
+extern void intern_reset(void);
+
+#endif
@@ -1,35 +1,32 @@
 #include <string.h>
 #include <keywords.h>
+#include <lextab.h>
 
+#define KEYWORD(token, name) name,
 char *keywords[] = {
-  "begin",
-  "if",
-  "then",
-  "else",
-  "while",
-  "do",
-  "repeat",
-  "until",
-  "var",
-  "boolean",
-  "integer",
-  "real",
-  "double",
-  "div",
-  "mod",
-  "and",
-  "or",
-  "not",
-  "true",
-  "false",
-  "end"};
+  KEYWORDS
+};
+#undef KEYWORD
 
-int iskeyword(const char *identifier)
+#define KEYWORD(token, name) sizeof name - 1,
+static unsigned char const keyword_length[] = {
+  KEYWORDS
+};
+#undef KEYWORD
+
+// iskeyword: one hash probe, then at most one comparison against the candidate,
+// folding the identifier's case as it goes; identifier is a slice of the source
+int iskeyword(const char *identifier, size_t length)
 {
-  int token;
-  for(token = BEGIN;token < END+1;token++) {
-    if(strcmp(keywords[token-BEGIN],identifier) == 0)
-      return token;
-  }
-  return 0;
+  unsigned char const *p = (unsigned char const *) identifier;
+  char const *keyword;
+  int token = lextab_keyword[KEYWORD_HASH(lextab_fold[p[0]], lextab_fold[p[length - 1]],
+    length, LEXTAB_KEYWORD_LENGTH, LEXTAB_KEYWORD_FIRST, LEXTAB_KEYWORD_LAST, LEXTAB_KEYWORD_SIZE)];
+
+  if(!token || keyword_length[token-BEGIN] != length)
+    return 0;
+  for (keyword = keywords[token-BEGIN]; length--; )
+    if (*keyword++ != lextab_fold[*p++])
+      return 0;
+  return token;
 }
@@ -1,26 +1,49 @@
+/*
+ * KEYWORDS is the single list of reserved words: it expands into the token
+ * enum below, into the keywords[] table of keywords.c and into the perfect
+ * hash lexgen builds for iskeyword. New keywords are added here only.
+ */
+#include <stddef.h>
+
+#define KEYWORDS \
+  KEYWORD(BEGIN,   "begin") \
+  KEYWORD(IF,      "if") \
+  KEYWORD(THEN,    "then") \
+  KEYWORD(ELSE,    "else") \
+  KEYWORD(WHILE,   "while") \
+  KEYWORD(DO,      "do") \
+  KEYWORD(REPEAT,  "repeat") \
+  KEYWORD(UNTIL,   "until") \
+  KEYWORD(VAR,     "var") \
+  KEYWORD(BOOLEAN, "boolean") \
+  KEYWORD(INTEGER, "integer") \
+  KEYWORD(REAL,    "real") \
+  KEYWORD(DOUBLE,  "double") \
+  KEYWORD(DIV,     "div") \
+  KEYWORD(MOD,     "mod") \
+  KEYWORD(AND,     "and") \
+  KEYWORD(OR,      "or") \
+  KEYWORD(NOT,     "not") \
+  KEYWORD(TRUE,    "true") \
+  KEYWORD(FALSE,   "false") \
+  KEYWORD(END,     "end")
+
+#define KEYWORD(token, name) token,
 enum {
-  BEGIN = 0x4097,
-  IF,
-  THEN,
-  ELSE,
-  WHILE,
-  DO,
-  REPEAT,
-  UNTIL,
-  VAR,
-  BOOLEAN,
-  INTEGER,
-  REAL,
-  DOUBLE,
-  DIV,
-  MOD,
-  AND,
-  OR,
-  NOT,
-  TRUE,
-  FALSE,
-  END
+  BEFORE_BEGIN = 0x4096,
+  KEYWORDS
 };
+#undef KEYWORD
+
+/*
+ * perfect hash of a reserved word on its length, first and last characters
+ * (in lower case); lexgen searches the multipliers that keep every keyword
+ * in its own slot
+ */
+#define KEYWORD_HASH(first, last, length, mlength, mfirst, mlast, size) \
+  (((length) * (mlength) \
+    + (unsigned char) (first) * (mfirst) \
+    + (unsigned char) (last) * (mlast)) & ((size) - 1))
 
 extern char *keywords[];
-extern int iskeyword(char const *identifier);
\ No newline at end of file
+extern int iskeyword(char const *identifier, size_t length);
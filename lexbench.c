@@ -0,0 +1,235 @@
+/**@<lexbench.c>::**/
+
+/*
+ * lexbench: lexer throughput on synthetic sources
+ *
+ * Generates a reproducible Pascal program of the requested size for each
+ * mix, writes it to a temporary file so that the tape maps it as mypas
+ * would, and times gettoken over it. The best of the repetitions is
+ * reported as MB/s of source and tokens/s.
+ *
+ * mixes: ident   long identifiers and assignments
+ *        number  decimal, octal, hex, float and double literals
+ *        nested  deeply nested begin/end, if and while
+ *        comment { } and (* *) blocks between short statements
+ *        mixed   all of the above in turn
+ *
+ * usage: lexbench [-s megabytes] [-r repetitions] [-seed n] [--lexer=hand|dfa]
+ *                 [mix...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <tokens.h>
+#include <lexer.h>
+#include <intern.h>
+
+static uint64_t seed = 0x9E3779B97F4A7C15, state;
+
+// xorshift64: the same seed gives the same program on every machine
+static uint64_t next(void)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+static unsigned pick(unsigned n)
+{
+  return next() % n;
+}
+
+static char const *words[] = {
+  "count", "total", "index", "value", "result", "buffer", "length", "offset",
+  "alpha", "beta", "gamma", "delta", "accumulator", "temporary", "x", "y",
+};
+#define NWORDS (sizeof words / sizeof *words)
+
+static char const *prose[] = {
+  "the", "loop", "below", "keeps", "a", "running", "sum", "of", "every",
+  "value", "seen", "so", "far", "and", "stops", "at", "zero", "(see", "above)",
+};
+#define NPROSE (sizeof prose / sizeof *prose)
+
+static void identifier(FILE *out)
+{
+  fprintf(out, "%s", words[pick(NWORDS)]);
+  if (pick(2))
+    fprintf(out, "%u", pick(1000));
+}
+
+static void number(FILE *out)
+{
+  switch (pick(6)) {
+  case 0: fprintf(out, "%u", pick(100000)); break;
+  case 1: fprintf(out, "0%o", pick(0777) + 1); break;
+  case 2: fprintf(out, "0x%X", pick(0x100000)); break;
+  case 3: fprintf(out, "%u.%u", pick(1000), pick(100000)); break;
+  case 4: fprintf(out, "%u.%ue%d", pick(10), pick(1000), (int) pick(60) - 30); break;
+  case 5: fprintf(out, "%u.%ud%d", pick(10), pick(100000), (int) pick(600) - 300); break;
+  }
+}
+
+static void ident_statement(FILE *out, int depth)
+{
+  int terms = 1 + pick(4);
+
+  fprintf(out, "%*s", 2 * depth, "");
+  identifier(out);
+  fprintf(out, " := ");
+  while (terms--) {
+    identifier(out);
+    fprintf(out, terms ? " %c " : ";\n", "+-*/"[pick(4)]);
+  }
+}
+
+static void number_statement(FILE *out, int depth)
+{
+  int terms = 1 + pick(4);
+
+  fprintf(out, "%*sx := ", 2 * depth, "");
+  while (terms--) {
+    number(out);
+    fprintf(out, terms ? " %c " : ";\n", "+-*/"[pick(4)]);
+  }
+}
+
+static void comment(FILE *out, int depth)
+{
+  int n = 4 + pick(40), brace = pick(2);
+
+  fprintf(out, "%*s%s", 2 * depth, "", brace ? "{" : "(*");
+  while (n--)
+    fprintf(out, "%s%s", prose[pick(NPROSE)], n % 12 ? " " : "\n");
+  fprintf(out, "%s\n", brace ? "}" : "*)");
+}
+
+static void nested(FILE *out, int depth)
+{
+  fprintf(out, "%*s%s ", 2 * depth, "", pick(2) ? "if" : "while");
+  identifier(out);
+  fprintf(out, " > 0 %s\n%*sbegin\n", pick(2) ? "then" : "do", 2 * depth, "");
+  if (depth < 40 && pick(8))
+    nested(out, depth + 1);
+  else
+    ident_statement(out, depth + 1);
+  fprintf(out, "%*send;\n", 2 * depth, "");
+}
+
+typedef void (*GENERATOR)(FILE *, int);
+
+static struct {
+  char const *name;
+  GENERATOR generate[4];
+} mixes[] = {
+  {"ident",   {ident_statement}},
+  {"number",  {number_statement}},
+  {"nested",  {nested}},
+  {"comment", {comment, ident_statement}},
+  {"mixed",   {ident_statement, number_statement, nested, comment}},
+};
+#define NMIXES (sizeof mixes / sizeof *mixes)
+
+// program: a source of about size bytes made of the statements of mix m
+static FILE *program(int m, long size)
+{
+  FILE *out = tmpfile();
+  int g = 0;
+
+  if (out == NULL)
+    return NULL;
+  state = seed; // each mix comes out the same whichever others run
+  fprintf(out, "var x, count, total : integer;\nbegin\n");
+  while (ftell(out) < size) {
+    mixes[m].generate[g](out, 1);
+    if (++g == 4 || mixes[m].generate[g] == NULL)
+      g = 0;
+  }
+  fprintf(out, "end.\n");
+  rewind(out);
+  return out;
+}
+
+static double seconds(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void bench(int m, long size, int repetitions)
+{
+  FILE *input = program(m, size);
+  TAPE *tape;
+  double best = 0, start, elapsed, megabytes;
+  long ntokens = 0;
+
+  if (input == NULL || (tape = tape_open(input)) == NULL) {
+    fprintf(stderr, "lexbench: cannot generate the %s program\n", mixes[m].name);
+    exit(1);
+  }
+  megabytes = (tape->tail - tape->head) / 1e6;
+
+  while (repetitions--) {
+    tape->cursor = tape->head;
+    ntokens = 0;
+    start = seconds();
+    while (gettoken(tape) != EOF)
+      ntokens++;
+    elapsed = seconds() - start;
+    if (best == 0 || elapsed < best)
+      best = elapsed;
+    intern_reset();
+  }
+
+  printf("%-8s %-4s %8.1f MB %10ld tokens %10.1f MB/s %10.1f Mtokens/s\n",
+    mixes[m].name, lexer_mode == DFA_LEXER ? "dfa" : "hand",
+    megabytes, ntokens, megabytes / best, ntokens / best / 1e6);
+  tape_close(tape);
+  fclose(input);
+}
+
+int main(int argc, char *argv[])
+{
+  long megabytes = 16;
+  int repetitions = 5, selected = 0, i;
+  unsigned m;
+  char run[NMIXES] = {0};
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      megabytes = atol(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      repetitions = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--lexer=hand") == 0) {
+      lexer_mode = HAND_LEXER;
+    } else if (strcmp(argv[i], "--lexer=dfa") == 0) {
+      lexer_mode = DFA_LEXER;
+    } else {
+      for (m = 0; m < NMIXES && strcmp(argv[i], mixes[m].name); m++);
+      if (m == NMIXES) {
+        fprintf(stderr, "usage: %s [-s megabytes] [-r repetitions] [-seed n] "
+          "[--lexer=hand|dfa] [ident|number|nested|comment|mixed...]\n", argv[0]);
+        return 1;
+      }
+      run[m] = selected = 1;
+    }
+  }
+  if (megabytes < 1 || repetitions < 1 || seed == 0) {
+    fprintf(stderr, "%s: size, repetitions and seed must be positive\n", argv[0]);
+    return 1;
+  }
+
+  for (m = 0; m < NMIXES; m++) {
+    if (!selected || run[m])
+      bench(m, megabytes * 1000000, repetitions);
+  }
+  return 0;
+}
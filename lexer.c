@@ -1,221 +1,580 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
+#include <stdint.h>
 #include <tokens.h>
 #include <keywords.h>
 #include <lexer.h>
-
-void skipspaces (FILE *tape)
+#include <lextab.h>
+#include <scan.h>
+#include <charclass.h>
+#include <intern.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// opening: leaves in lexval where the comment at p opens
+static void opening (TAPE const *tape, unsigned char const *p)
 {
-  int cake;
+  int line, column;
 
-  while ( isspace ( cake = getc (tape) ) && cake != (' ' | '\n' | '\t') );
-  ungetc ( cake, tape );
+  tape_count (tape, tape->base + (p - tape->head), &line, &column);
+  lexval.opening.line = line;
+  lexval.opening.column = column;
 }
 
-char lexeme[MAXID_SIZE+1];
+/* skipcomment: p is on a { ... } or (* ... *) comment (which do not nest);
+returns the byte after it, or NULL when the comment is never closed, with
+in lexval where it opens. On a streamed tape the window slides along as
+long as the comment lasts, so that place is taken before the first slide */
+static unsigned char const *skipcomment (TAPE *tape, unsigned char const *p)
+{
+  unsigned char close = *p == '{' ? '}' : ')';
+  unsigned char const *start = p;
 
-// ASGN = :=
-int is_assign(FILE * tape){
+  if (close == ')' && p + 2 >= tape->tail) {
+    opening (tape, start);
+    return NULL;
+  }
+  // the ')' of "(*)" still belongs to the opening delimiter
+  p += close == '}' ? 1 : 3;
+  for (;;) {
+    p = scan_to (p, close);
+    if (p == tape->tail) {
+      if (start)
+        opening (tape, start);
+      if (tape->stream == NULL)
+        return NULL;
+      start = NULL; // gone with the slide
+      p = tape_refill (tape, p - 1) + 1; // the byte before may be the '*' of "*)"
+    } else if (*p == close && (close == '}' || p[-1] == '*')) {
+      return p + 1;
+    } else {
+      p++; // a ')' alone, or a 0 inside
+    }
+  }
+}
 
-  if((lexeme[0] = getc(tape)) == ':'){
-    if((lexeme[1] = getc(tape)) == '='){
-      lexeme[2] = 0;
-      return ASGN;
+/* skipspaces: moves the cursor past blanks and comments; returns 0 when a
+comment is never closed, with the cursor at the tail and in lexval the line
+and column the comment opens at */
+static int skipspaces (TAPE *tape)
+{
+  unsigned char const *p = tape->cursor, *end;
+
+  // comments are whitespace to the parser
+  for (;;) {
+    while ((p = scan_spaces (p)) == tape->tail && tape->stream)
+      p = tape_refill (tape, p);
+    // a streamed tape keeps half a window ahead, enough for any token
+    if (tape->stream && (size_t) (tape->tail - p) < tape->window / 2)
+      p = tape_refill (tape, p);
+    if (!(*p == '{' || (*p == '(' && p[1] == '*')))
+      break;
+    if ((end = skipcomment (tape, p)) == NULL) {
+      tape->cursor = tape->tail;
+      return 0;
     }
-    ungetc(lexeme[1], tape);
+    p = end;
   }
-  ungetc(lexeme[0], tape);
-  return 0;
+  tape->cursor = p;
+  return 1;
 }
 
-// ID = [A-Za-z][A-Za-z0-9]*
-int is_identifier(FILE *tape)
+_Thread_local char lexeme[LEXEME_SIZE+1];
+_Thread_local LEXVAL lexval;
+
+/* --lex-stats counters of the calling thread, see timed_gettoken and count_token */
+enum { SPACES, OPERATOR, IDENTIFIER, NUMBER, DFA, SINGLE, RECOGNIZERS };
+
+#define LENGTHS 32 // identifier lengths 1 to 31 one by one, then 32 and longer
+
+static _Thread_local struct lexstats {
+  uint64_t single[256];              // one-character tokens, by character
+  uint64_t named[UNTERMINATED - ID + 1]; // ID, the literal classes, ASGN, ...
+  uint64_t keyword[END - BEGIN + 1];
+  uint64_t eof;
+  uint64_t length[LENGTHS + 1];      // of IDs and keywords
+  uint64_t calls[RECOGNIZERS], hits[RECOGNIZERS], cycles[RECOGNIZERS];
+  uint64_t backedoff;                // bytes read past the tokens taken, see timed_gettoken
+} stats;
+
+// accept: copies the recognized bytes [cursor, end) into lexeme, moves the cursor past them
+// and returns the lexeme length
+static int accept(TAPE *tape, unsigned char const *end)
+{
+  size_t length = end - tape->cursor;
+
+  if (length > LEXEME_SIZE)
+    length = LEXEME_SIZE;
+  memcpy(lexeme, tape->cursor, length);
+  lexeme[length] = 0;
+  tape->cursor = end;
+  return length;
+}
+
+/* OPERATOR = ':=' | '<=' | '>=' | '<>' | '..', picked by one switch on the
+first byte; every other operator is a single-character token */
+int is_operator(TAPE *tape)
 {
   int token = 0;
-  lexeme[token] = getc(tape);
-  if (isalpha (lexeme[token]) ) {
-    for(token = 1; isalnum(lexeme[token] = getc(tape)); token ++) {
-      if(token == MAXID_SIZE)
-        break;
-    }
-    ungetc (lexeme[token], tape);
-    lexeme[token] = 0;
+  unsigned char const *p = tape->cursor;
+
+  switch (p[0]) {
+  case ':':
+    if (p[1] == '=') token = ASGN;
+    break;
+  case '<':
+    if (p[1] == '=') token = LEQ;
+    else if (p[1] == '>') token = NEQ;
+    break;
+  case '>':
+    if (p[1] == '=') token = GEQ;
+    break;
+  case '.':
+    if (p[1] == '.') token = RANGE;
+    break;
+  }
+  if (token)
+    accept(tape, p + 2);
+  return token;
+}
 
-    token = iskeyword(lexeme);
+// ID = [A-Za-z][A-Za-z0-9]*
+int is_identifier(TAPE *tape)
+{
+  int token;
+  unsigned char const *start = tape->cursor, *p = start;
+
+  if (charis (*p, CHAR_LETTER)) {
+    p = scan_alnum (p + 1);
+    tape->cursor = p; // names are never copied: [start, p) is the name
+
+    token = iskeyword((char const *) start, p - start);
     if(token)
       return token;
 
-    return ID;
+    return ID; // interned by gettoken, once the name is known to be whole
   }
-  ungetc (lexeme[token], tape);
   return 0;
 }
 
-// DEC = [1-9][0-9]* | 0
-int is_decimal(FILE *tape)
-{
-  int i = 0;
-  if (isdigit (lexeme[i] = getc(tape))) {
-    if (lexeme[i] == '0') {
-      if( (lexeme[++i] = getc(tape)) == '0' || lexeme[i] == EOF || lexeme[i] == EOL ) {
-        return INTCONST;
-      } else if (lexeme[i] == '.' || tolower(lexeme[i]) == 'e') {
-        //for later float verification
-        ungetc (lexeme[i], tape);
-        lexeme[i] = 0;
-        return INTCONST;
-      } else {
-        ungetc (lexeme[i], tape);
-        ungetc (lexeme[i-1], tape);
-        return 0;
-      }
-    }
-    // [0-9]*
-    for (i=1; isdigit (lexeme[i] = getc(tape)); i++);
-    ungetc (lexeme[i], tape);
-    lexeme[i] = 0;
-    return INTCONST;
-  }
-  ungetc (lexeme[i], tape);
-  return 0;
-}
+/* decode: leaves the binary value of the numeric literal [p, end) in lexval.
 
-// OCTAL =  0[1-7][0-7]*
-int is_octal(FILE *tape)
+Integers saturate at INT64_MAX. Reals are correctly rounded to their own
+precision (float for FLTCONST, double for DBLCONST): when the significand
+and the power of ten are both exactly representable, one multiplication or
+division by an exact power is correctly rounded (Clinger's fast path);
+the rare remaining literals go through strtof/strtod. */
+static void decode(int token, unsigned char const *start, unsigned char const *end)
 {
-  int i = 0;
-  lexeme[i] = getc(tape);
-  if (lexeme[i] == '0') {
-    lexeme[++i] = getc(tape);
-    if ( lexeme[i] >= '1' && lexeme[i] <= '7') {
-      while ( (lexeme[++i] = getc(tape)) >= '0' && lexeme[i] <= '7');
-      ungetc (lexeme[i], tape);
-      return OCTAL;
+  static double const exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  uint64_t significand = 0, digit;
+  int base = 10, exponent = 0, exponent_sign = 1, digits = 0, e = 0, fraction = 0;
+  char buffer[64], *text = buffer;
+  unsigned char const *p = start;
+  size_t length;
+
+  switch (token) {
+    case HEX:
+      base = 16;
+      p += 2;
+      break;
+    case OCTAL:
+      base = 8;
+      p++;
+      break;
+    case INTCONST:
+      break;
+    default:
+      goto real;
+  }
+  for (; p < end; p++) {
+    digit = charis (*p, CHAR_DIGIT) ? *p - '0' : lextab_fold[*p] - 'a' + 10;
+    if (significand > (INT64_MAX - digit) / base) {
+      significand = INT64_MAX;
+      break;
+    }
+    significand = significand * base + digit;
+  }
+  lexval.integer = significand;
+  return;
+
+  real:
+  for (; p < end && (charis (*p, CHAR_DIGIT) || *p == '.'); p++) {
+    if (*p == '.') {
+      fraction = 1;
+    } else if (digits < 19) {
+      // leading zeros are not significant digits
+      if ((significand = significand * 10 + *p - '0'))
+        digits++;
+      exponent -= fraction;
     } else {
-      ungetc (lexeme[i], tape);
-      ungetc (lexeme[i-1], tape);
-      return 0;
+      exponent += !fraction; // digits beyond the 19th only scale the value
+      digits++;
     }
   }
-  ungetc (lexeme[i], tape);
-  return 0;
-}
+  if (p < end) { // exponent part
+    p++;
+    if (*p == '+' || *p == '-')
+      exponent_sign = *p++ == '-' ? -1 : 1;
+    for (; p < end && e < 100000; p++)
+      e = e * 10 + *p - '0';
+    exponent += exponent_sign * e;
+  }
 
-// HEX = 0[xX][0-9a-fA-F]+
-int is_hexadecimal(FILE *tape)
-{
-  int i = 0;
-  lexeme[i] = getc(tape);
-  if (lexeme[i] == '0') {
-    if ( tolower((lexeme[++i] = getc(tape))) == 'x'){
-      lexeme[++i] = getc(tape);
-      if ( isdigit(lexeme[i]) || (tolower(lexeme[i]) >= 'a' && tolower(lexeme[i]) <= 'f') ) {
-        while ( isdigit((lexeme[++i] = getc(tape))) || (tolower(lexeme[i]) >= 'a' && tolower(lexeme[i]) <= 'f') );
-        ungetc(lexeme[i],tape);
-        return HEX;
-
-      } else {
-        ungetc(lexeme[i],tape);
-        ungetc(lexeme[i-1],tape);
-        ungetc(lexeme[i-2],tape);
-        return 0;
-      }
-
-    } else{
-      ungetc(lexeme[i],tape);
-      ungetc(lexeme[i-1],tape);
-      return 0;
+  if (digits <= 19) {
+    if (token == FLTCONST && significand <= (1 << 24) && exponent >= -10 && exponent <= 10) {
+      lexval.real = exponent < 0 ? (float) significand / (float) exact[-exponent]
+                                 : (float) significand * (float) exact[exponent];
+      return;
     }
+    if (token == DBLCONST && significand <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+      lexval.real = exponent < 0 ? (double) significand / exact[-exponent]
+                                 : (double) significand * exact[exponent];
+      return;
+    }
+  }
 
-  } else {
-    ungetc(lexeme[i],tape);
+  // slow path, on a copy since strtod does not understand the D exponent marker
+  length = end - start;
+  if (length >= sizeof buffer && (text = malloc(length + 1)) == NULL) {
+    lexval.real = 0;
+    return;
   }
-  return 0;
+  for (p = start; p < end; p++)
+    text[p - start] = lextab_fold[*p] == 'd' ? 'e' : *p;
+  text[length] = 0;
+  lexval.real = token == FLTCONST ? strtof(text, NULL) : strtod(text, NULL);
+  if (text != buffer)
+    free(text);
 }
 
-/* FLOAT = ( DEC ‘.’ DIGIT* | ‘.’ DIGIT+ ) EXP? | DEC EXP
+// literal: decodes and accepts the numeric literal [cursor, end)
+static int literal(TAPE *tape, unsigned char const *end, int token)
+{
+  decode(token, tape->cursor, end);
+  accept(tape, end);
+  return token;
+}
+
+/* NUMBER classifies every numeric literal in one forward scan, touching each
+byte once: the longest prefix matching one of
+
+DEC = [1-9][0-9]* | 0
+OCTAL = 0[1-7][0-7]*
+HEX = 0[xX][0-9a-fA-F]+
+FLOAT = ( DEC ‘.’ DIGIT* | ‘.’ DIGIT+ ) EXP? | DEC EXP
+DBL = ( DEC ‘.’ DIGIT* | ‘.’ DIGIT+ ) DEXP | DEC DEXP
 
 DIGIT = [0-9]
-EXP =  ('E'|'e') (‘+’|‘-’)? DIGIT+  */
-int is_float(FILE *tape) {
-
-  int i;
-  if (is_decimal(tape)) { // begins as decimal
-
-    i = strlen(lexeme);
-    lexeme[i] = getc(tape);
-
-    if (lexeme[i] == '.'){
-      for(i++; isdigit(lexeme[i] = getc(tape)); i++);
-      ungetc(lexeme[i], tape);
-      lexeme[i] = 0;
-      return FLTCONST;
-    } else if (tolower(lexeme[i]) == 'e') {
-      lexeme[++i] = getc(tape);
-
-      if (isdigit(lexeme[i]) || lexeme[i] == '+' || lexeme[i] == '-') {
-        lexeme[++i] = getc(tape);
-        if (isdigit(lexeme[i])) {
-          for(i++; isdigit(lexeme[i] = getc(tape)); i++);
-          ungetc(lexeme[i], tape);
-          lexeme[i] = 0;
-          return FLTCONST;
-        }
-      }
-
-      ungetc(lexeme[i], tape);
-      lexeme[i] = 0;
+EXP =  ('E'|'e') (‘+’|‘-’)? DIGIT+
+DEXP =  ('D'|'d') (‘+’|‘-’)? DIGIT+
 
-      return 0;
+is taken; a ‘.’ followed by another ‘.’ is left alone, since ‘..’ is a range */
+int is_number(TAPE *tape)
+{
+  int token = INTCONST;
+  unsigned char const *p = tape->cursor, *q;
+
+  if (*p == '0') {
+    if (lextab_fold[p[1]] == 'x' && charis (p[2], CHAR_HEX)) {
+      for (p += 3; charis (*p, CHAR_HEX); p++);
+      return literal(tape, p, HEX);
     }
+    if (charis (p[1], CHAR_OCTAL) && p[1] != '0') {
+      for (p += 2; charis (*p, CHAR_OCTAL); p++);
+      return literal(tape, p, OCTAL);
+    }
+    p++;
+  } else if (charis (*p, CHAR_DIGIT)) {
+    while (charis (*++p, CHAR_DIGIT));
+  } else if (*p != '.' || !charis (p[1], CHAR_DIGIT)) {
+    return 0;
+  }
 
-    ungetc(lexeme[i], tape);
-    lexeme[i] = 0;
-    return INTCONST;
+  // fraction
+  if (*p == '.' && p[1] != '.') {
+    while (charis (*++p, CHAR_DIGIT));
+    token = FLTCONST;
   }
 
-  lexeme[0] = getc(tape);
-  if (lexeme[0] == '.') {
+  // exponent, only taken when at least one digit follows
+  if (lextab_fold[*p] == 'e' || lextab_fold[*p] == 'd') {
+    q = p + 1;
+    if (*q == '+' || *q == '-')
+      q++;
+    if (charis (*q, CHAR_DIGIT)) {
+      while (charis (*++q, CHAR_DIGIT));
+      token = lextab_fold[*p] == 'd' ? DBLCONST : FLTCONST;
+      p = q;
+    } else if (lex_stats) {
+      stats.backedoff += q - p;
+    }
+  }
 
-    i = 1;
-    if (isdigit(lexeme[i] = getc(tape))) {
-      for(i++; isdigit(lexeme[i] = getc(tape)); i++);
-      ungetc(lexeme[i], tape);
-      lexeme[i] = 0;
-      return FLTCONST;
+  return literal(tape, p, token);
+}
+
+/* dfa_gettoken: maximal munch driven by the transition table lexgen builds
+from the regular definitions above, one table lookup per byte */
+int dfa_gettoken (TAPE *tape)
+{
+  int state = LEXTAB_START, token = 0, shorter = 0;
+  unsigned char const *start = tape->cursor, *p = start, *end = NULL, *shorter_end = NULL;
+
+  while ((state = lextab_delta[state][lextab_class[*p]]) != LEXTAB_DEAD) {
+    p++;
+    if (lextab_accept[state]) {
+      shorter = token;
+      shorter_end = end;
+      token = lextab_accept[state];
+      end = p;
     }
-    ungetc(lexeme[1], tape);
   }
-  ungetc(lexeme[0], tape);
-  return 0;
+  // a fraction point followed by another '.' belongs to a range '..'
+  if (token == FLTCONST && end[-1] == '.' && *end == '.') {
+    token = shorter;
+    end = shorter_end;
+  }
+  if (token == 0)
+    return 0;
+  if (lex_stats)
+    stats.backedoff += p - end;
+
+  if (token >= INTCONST && token <= DBLCONST)
+    return literal(tape, end, token);
+
+  if (token != ID) { // an operator
+    accept(tape, end);
+    return token;
+  }
+  tape->cursor = end;
+  if ((state = iskeyword((char const *) start, end - start)))
+    return state;
+  return token; // interned by gettoken
 }
 
-// gettoken verifies token by token of the given input
-int gettoken (FILE *tokenstream)
+// single: the one-character token at the cursor, or EOF at the tail
+static int single (TAPE *tape)
+{
+  if (tape->cursor == tape->tail)
+    return EOF;
+  lexeme[0] = *tape->cursor++;
+  lexeme[1] = 0;
+  return (unsigned char) lexeme[0];
+}
+
+/*
+ * --lex-stats: gettoken then goes through timed_gettoken, which times
+ * every recognizer it tries, and count_token classifies the token it
+ * finally returns; with the option off the only cost is one test per token. Backed-off bytes are
+ * those a recognizer read past the token it finally took (the "e+" of
+ * "1e+x", the tail of a failed DFA path): the work an ungetc used to undo.
+ */
+
+int lex_stats = 0;
+
+static char const *recognizer_name[RECOGNIZERS] = {
+  "skipspaces", "is_operator", "is_identifier", "is_number", "dfa_gettoken", "single",
+};
+
+static char const *named_name[UNTERMINATED - ID + 1] = {
+  "ID", "INTCONST", "OCTAL", "HEX", "FLTCONST", "DBLCONST", "ASGN", "GEQ", "LEQ", "NEQ",
+  "RANGE", "UNTERMINATED",
+};
+
+// cycles: the time stamp counter where there is one, nanoseconds elsewhere
+static uint64_t cycles (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc ();
+#else
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+#endif
+}
+
+// TIMED: token = call, timed and counted for recognizer; a hit is a nonzero token
+#define TIMED(recognizer, call) do { \
+    uint64_t start = cycles (); \
+    token = (call); \
+    stats.cycles[recognizer] += cycles () - start; \
+    stats.calls[recognizer]++; \
+    stats.hits[recognizer] += token != 0; \
+  } while (0)
+
+static int timed_gettoken (TAPE *tape)
+{
+  int token, closed;
+  size_t before = tape->base + (tape->cursor - tape->head);
+
+  TIMED (SPACES, closed = skipspaces (tape));
+  // a hit is a call that skipped something (the window of a stream may have moved)
+  stats.hits[SPACES] += !closed - (before == tape->base + (tape->cursor - tape->head));
+  tape->token = tape->cursor;
+
+  if (!closed) {
+    token = UNTERMINATED;
+  } else if (lexer_mode == DFA_LEXER) {
+    TIMED (DFA, dfa_gettoken (tape));
+  } else {
+    token = 0;
+    if (charis (*tape->cursor, CHAR_LETTER))
+      TIMED (IDENTIFIER, is_identifier (tape));
+    if (!token && charis (*tape->cursor, CHAR_OPERATOR))
+      TIMED (OPERATOR, is_operator (tape));
+    if (!token && (charis (*tape->cursor, CHAR_DIGIT) || *tape->cursor == '.'))
+      TIMED (NUMBER, is_number (tape));
+  }
+  if (token == 0)
+    TIMED (SINGLE, single (tape));
+  return token;
+}
+
+// count_token: classifies the token gettoken returns, [tape->token, tape->cursor)
+static void count_token (TAPE *tape, int token)
+{
+  size_t length;
+
+  if (token == EOF) {
+    stats.eof++;
+  } else if (token < 256) {
+    stats.single[token]++;
+  } else if (token >= BEGIN && token <= END) {
+    stats.keyword[token - BEGIN]++;
+  } else if (token >= ID && token <= UNTERMINATED) {
+    stats.named[token - ID]++;
+  }
+  if (token == ID || (token >= BEGIN && token <= END)) {
+    length = tape->cursor - tape->token;
+    stats.length[length < LENGTHS ? length : LENGTHS]++;
+  }
+}
+
+// lexstats_print: writes what gettoken did on the calling thread since the last reset
+void lexstats_print (FILE *out)
+{
+  uint64_t total = stats.eof;
+  int k;
+
+  for (k = 0; k < 256; k++) total += stats.single[k];
+  for (k = 0; k <= UNTERMINATED - ID; k++) total += stats.named[k];
+  for (k = 0; k <= END - BEGIN; k++) total += stats.keyword[k];
+
+  fprintf (out, "tokens: %llu\n", (unsigned long long) total);
+  for (k = 0; k <= UNTERMINATED - ID; k++)
+    if (stats.named[k])
+      fprintf (out, "  %-14s %12llu\n", named_name[k], (unsigned long long) stats.named[k]);
+  for (k = 0; k <= END - BEGIN; k++)
+    if (stats.keyword[k])
+      fprintf (out, "  %-14s %12llu\n", keywords[k], (unsigned long long) stats.keyword[k]);
+  for (k = 0; k < 256; k++)
+    if (stats.single[k])
+      fprintf (out, "  '%c'%11s %12llu\n", k >= ' ' && k < 0x7f ? k : '?', "", (unsigned long long) stats.single[k]);
+  fprintf (out, "  %-14s %12llu\n", "EOF", (unsigned long long) stats.eof);
+
+  fprintf (out, "name lengths:\n");
+  for (k = 1; k <= LENGTHS; k++)
+    if (stats.length[k])
+      fprintf (out, "  %2d%s %21llu\n", k, k == LENGTHS ? "+" : " ", (unsigned long long) stats.length[k]);
+  fprintf (out, "backed-off bytes: %llu\n", (unsigned long long) stats.backedoff);
+
+  fprintf (out, "%-14s %12s %12s %14s %10s\n", "recognizer", "calls", "hits", "cycles", "per call");
+  for (k = 0; k < RECOGNIZERS; k++)
+    if (stats.calls[k])
+      fprintf (out, "%-14s %12llu %12llu %14llu %10.1f\n", recognizer_name[k],
+        (unsigned long long) stats.calls[k], (unsigned long long) stats.hits[k],
+        (unsigned long long) stats.cycles[k], (double) stats.cycles[k] / stats.calls[k]);
+}
+
+void lexstats_reset (void)
+{
+  memset (&stats, 0, sizeof stats);
+}
+
+/* lexstats_save: a copy of what gettoken did on the calling thread, for a
+thread that lexes on behalf of another (--parallel-lex); NULL when out of memory */
+LEXSTATS *lexstats_save (void)
+{
+  LEXSTATS *saved = malloc (sizeof *saved);
+
+  if (saved != NULL)
+    *saved = stats;
+  return saved;
+}
+
+// lexstats_add: adds saved counters to the calling thread's and frees them
+void lexstats_add (LEXSTATS *saved)
+{
+  uint64_t *to = (uint64_t *) &stats, *from = (uint64_t *) saved;
+  size_t k;
+
+  if (saved == NULL)
+    return;
+  for (k = 0; k < sizeof stats / sizeof (uint64_t); k++) // every member is a counter
+    to[k] += from[k];
+  free (saved);
+}
+
+int lexer_mode = HAND_LEXER;
+
+static int lex_token (TAPE *tokenstream)
 {
   int token;
-  skipspaces (tokenstream);
 
-  token = is_assign(tokenstream);
-  if (token) return token;
+  if (!skipspaces (tokenstream)) {
+    tokenstream->token = tokenstream->cursor;
+    return UNTERMINATED;
+  }
+  tokenstream->token = tokenstream->cursor;
 
-  token = is_identifier(tokenstream);
-  if (token) return token;
+  if (lexer_mode == DFA_LEXER) {
+    token = dfa_gettoken(tokenstream);
+    if (token) return token;
+  } else {
+    // the class of the first byte picks the recognizers that can match it
+    unsigned char class = lextab_charclass[*tokenstream->cursor];
 
-  token = is_decimal (tokenstream);
-  if (token) return token;
+    if (class & CHAR_LETTER)
+      return is_identifier(tokenstream);
 
-  token = is_float(tokenstream);
-  if (token) return token;
+    if (class & CHAR_OPERATOR) {
+      token = is_operator(tokenstream);
+      if (token) return token;
+    }
 
-  token = is_octal(tokenstream);
-  if (token) return token;
+    if (class & CHAR_DIGIT || *tokenstream->cursor == '.') {
+      token = is_number (tokenstream);
+      if (token) return token;
+    }
+  }
 
-  token = is_hexadecimal (tokenstream);
-  if (token) return token;
+  return single (tokenstream);
+}
+
+// gettoken verifies token by token of the given input
+int gettoken (TAPE *tokenstream)
+{
+  int token;
 
-  token = getc (tokenstream);
+  for (;;) {
+    token = lex_stats ? timed_gettoken (tokenstream) : lex_token (tokenstream);
+    // a token ending closer than LOOKAHEAD to the end of a window may go on past it
+    if ((size_t) (tokenstream->tail - tokenstream->cursor) >= LOOKAHEAD || !tape_grow (tokenstream))
+      break;
+    tokenstream->cursor = tokenstream->token; // again, in the wider window
+  }
+  // only now is the token whole: a name cut off by the window is never interned or counted
+  if (token == ID)
+    lexval.id = intern ((char const *) tokenstream->token, tokenstream->cursor - tokenstream->token);
+  if (lex_stats)
+    count_token (tokenstream, token);
   return token;
 }
@@ -1,3 +1,43 @@
-#define MAXID_SIZE 32
-extern char lexeme[MAXID_SIZE+1];//@ lexer.c
-extern int gettoken (FILE *);
+#ifndef _LEXER_H_
+#define _LEXER_H_
+
+#include <stdint.h>
+#include <tape.h>
+/* lexeme: text of the last token, up to LEXEME_SIZE bytes of it. Names are
+the exception: an ID or keyword is never copied, its text is the slice
+[tape->token, tape->cursor) of the source, of any length, and the interned
+copy (intern_name(lexval.id)) is made on its first occurrence only */
+#define LEXEME_SIZE 32
+extern _Thread_local char lexeme[LEXEME_SIZE+1];//@ lexer.c
+extern int gettoken (TAPE *);
+
+/* LOOKAHEAD: bytes a recognizer may read past the token it returns before
+backing off (the "e+x" after 1.5, the second dot of "1.."). A token ending
+closer than that to an edit (tokbuf_relex) or to the end of a streamed
+window (gettoken) may come out different once the bytes there change */
+#define LOOKAHEAD 4
+
+/* lexval: value the last token carries along with its lexeme */
+typedef union {
+  uint32_t id;     // ID: interned name, see intern.h
+  int64_t integer; // INTCONST, OCTAL, HEX
+  double real;     // FLTCONST (rounded to float precision), DBLCONST
+  struct {
+    uint32_t line, column;
+  } opening;       // UNTERMINATED: where the comment left open starts
+} LEXVAL;
+extern _Thread_local LEXVAL lexval;//@ lexer.c
+
+#define HAND_LEXER 0 // the hand-written is_* recognizers
+#define DFA_LEXER  1 // the transition table generated by lexgen
+extern int lexer_mode;//@ lexer.c
+
+/* --lex-stats: count and time what gettoken does, per thread */
+extern int lex_stats;//@ lexer.c
+extern void lexstats_print (FILE *);
+extern void lexstats_reset (void);
+typedef struct lexstats LEXSTATS;
+extern LEXSTATS *lexstats_save (void);
+extern void lexstats_add (LEXSTATS *);
+
+#endif
@@ -0,0 +1,585 @@
+/**@<lexgen.c>::**/
+
+/*
+ * lexgen: build-time generator of the table-driven lexer
+ *
+ * The regular definitions documented above the recognizers in lexer.c are
+ * restated below; lexgen turns them into a Thompson NFA, runs the subset
+ * construction over byte equivalence classes, minimizes the result with
+ * Moore's partition refinement and writes the transition table to
+ * lextab.h/lextab.c, which lexer.c drives when the dfa lexer is selected.
+ *
+ * It also searches the multipliers of KEYWORD_HASH (keywords.h) that give
+ * the reserved words a collision-free table, used by iskeyword, and writes
+ * the byte class table of charclass.h and the table that folds letters to
+ * lower case for case-insensitive names.
+ *
+ * regular expression syntax: x  \x  [a-z]  {NAME}  ( )  |  *  +  ?
+ *
+ * usage: lexgen lextab.h lextab.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <keywords.h>
+#include <charclass.h>
+
+static struct {
+  char const *name;
+  char const *regex;
+} definitions[] = {
+  {"DIGIT", "[0-9]"},
+  {"DEC",   "[1-9]{DIGIT}*|0"},
+  {"OCTAL", "0[1-7][0-7]*"},
+  {"HEX",   "0[xX][0-9a-fA-F]+"},
+  {"EXP",   "[Ee][+\\-]?{DIGIT}+"},
+  {"DEXP",  "[Dd][+\\-]?{DIGIT}+"},
+  {"FRAC",  "{DEC}\\.{DIGIT}*|\\.{DIGIT}+"},
+  {"FLOAT", "({FRAC}){EXP}?|{DEC}{EXP}"},
+  {"DBL",   "({FRAC}){DEXP}|{DEC}{DEXP}"},
+  {"ID",    "[A-Za-z][A-Za-z0-9]*"},
+  {"ASGN",  ":="},
+  {"LEQ",   "<="},
+  {"GEQ",   ">="},
+  {"NEQ",   "<>"},
+  {"RANGE", "\\.\\."},
+};
+
+/* token rules, in priority order when two rules accept the same lexeme */
+static struct {
+  char const *definition;
+  char const *token; // symbolic name from tokens.h
+} rules[] = {
+  {"ASGN",  "ASGN"},
+  {"LEQ",   "LEQ"},
+  {"GEQ",   "GEQ"},
+  {"NEQ",   "NEQ"},
+  {"RANGE", "RANGE"},
+  {"ID",    "ID"},
+  {"DEC",   "INTCONST"},
+  {"OCTAL", "OCTAL"},
+  {"HEX",   "HEX"},
+  {"FLOAT", "FLTCONST"},
+  {"DBL",   "DBLCONST"},
+};
+
+#define NDEFINITIONS (sizeof definitions / sizeof definitions[0])
+#define NRULES       (sizeof rules / sizeof rules[0])
+
+#define MAX_NFA_STATES 0x1000
+#define MAX_DFA_STATES 0x400
+#define MAX_CHARSETS   0x100
+
+static void fatal(char const *message, char const *context)
+{
+  fprintf(stderr, "lexgen: %s: %s\n", message, context);
+  exit(1);
+}
+
+/************************************ NFA *************************************/
+
+/* every NFA state has either one edge on a byte set or up to two epsilons */
+static int nfa_charset[MAX_NFA_STATES]; // index in charsets, -1 for epsilon
+static int nfa_next[MAX_NFA_STATES][2];
+static int nfa_rule[MAX_NFA_STATES];    // accepting rule + 1, 0 otherwise
+static int nfa_nstates = 0;
+
+static unsigned char charsets[MAX_CHARSETS][256];
+static int ncharsets = 0;
+
+static int nfa_state(void)
+{
+  if (nfa_nstates == MAX_NFA_STATES)
+    fatal("too many NFA states", "raise MAX_NFA_STATES");
+  nfa_charset[nfa_nstates] = -1;
+  nfa_next[nfa_nstates][0] = nfa_next[nfa_nstates][1] = -1;
+  nfa_rule[nfa_nstates] = 0;
+  return nfa_nstates++;
+}
+
+static void epsilon(int from, int to)
+{
+  nfa_next[from][nfa_next[from][0] < 0 ? 0 : 1] = to;
+}
+
+/* a fragment is the pair (entry, exit) of a sub-automaton */
+typedef struct {
+  int entry, exit;
+} FRAGMENT;
+
+static char const *regex; // parse cursor
+static char const *regex_context;
+
+static FRAGMENT alternation(void);
+
+static int escape(void)
+{
+  if (*regex == '\\') {
+    regex++;
+    if (*regex == 0)
+      fatal("dangling escape", regex_context);
+  }
+  return (unsigned char) *regex++;
+}
+
+static FRAGMENT charset_fragment(unsigned char const *set)
+{
+  FRAGMENT f;
+
+  if (ncharsets == MAX_CHARSETS)
+    fatal("too many character sets", "raise MAX_CHARSETS");
+  memcpy(charsets[ncharsets], set, 256);
+  f.entry = nfa_state();
+  f.exit = nfa_state();
+  nfa_charset[f.entry] = ncharsets++;
+  nfa_next[f.entry][0] = f.exit;
+  return f;
+}
+
+static FRAGMENT reference(void)
+{
+  char name[64];
+  char const *resume, *resume_context;
+  int i, n = 0;
+  FRAGMENT f;
+
+  while (*regex && *regex != '}' && n < (int) sizeof name - 1)
+    name[n++] = *regex++;
+  name[n] = 0;
+  if (*regex++ != '}')
+    fatal("unterminated {reference}", regex_context);
+
+  for (i = 0; i < NDEFINITIONS; i++) {
+    if (strcmp(definitions[i].name, name) == 0)
+      break;
+  }
+  if (i == NDEFINITIONS)
+    fatal("undefined reference", name);
+
+  resume = regex;
+  resume_context = regex_context;
+  regex = regex_context = definitions[i].regex;
+  f = alternation();
+  if (*regex)
+    fatal("unbalanced parenthesis", regex_context);
+  regex = resume;
+  regex_context = resume_context;
+  return f;
+}
+
+static FRAGMENT atom(void)
+{
+  unsigned char set[256];
+  int first, last, negate = 0;
+  FRAGMENT f;
+
+  memset(set, 0, sizeof set);
+  switch (*regex) {
+    case '(':
+      regex++;
+      f = alternation();
+      if (*regex++ != ')')
+        fatal("missing ')'", regex_context);
+      return f;
+
+    case '{':
+      regex++;
+      return reference();
+
+    case '[':
+      regex++;
+      if (*regex == '^') {
+        negate = 1;
+        regex++;
+      }
+      while (*regex && *regex != ']') {
+        first = last = escape();
+        if (*regex == '-' && regex[1] && regex[1] != ']') {
+          regex++;
+          last = escape();
+        }
+        for (; first <= last; first++)
+          set[first] = 1;
+      }
+      if (*regex++ != ']')
+        fatal("missing ']'", regex_context);
+      if (negate) {
+        for (first = 0; first < 256; first++)
+          set[first] = !set[first];
+      }
+      return charset_fragment(set);
+
+    case 0: case '|': case ')': case '*': case '+': case '?':
+      fatal("operand expected", regex_context);
+
+    default:
+      set[escape()] = 1;
+      return charset_fragment(set);
+  }
+}
+
+static FRAGMENT closure(void)
+{
+  FRAGMENT f = atom(), g;
+
+  for (;;) {
+    switch (*regex) {
+      case '*': case '+': case '?':
+        g.entry = nfa_state();
+        g.exit = nfa_state();
+        epsilon(g.entry, f.entry);
+        epsilon(f.exit, g.exit);
+        if (*regex != '+')
+          epsilon(g.entry, g.exit);
+        if (*regex != '?')
+          epsilon(f.exit, f.entry);
+        f = g;
+        regex++;
+        continue;
+    }
+    return f;
+  }
+}
+
+static FRAGMENT concatenation(void)
+{
+  FRAGMENT f = closure(), g;
+
+  while (*regex && *regex != '|' && *regex != ')') {
+    g = closure();
+    epsilon(f.exit, g.entry);
+    f.exit = g.exit;
+  }
+  return f;
+}
+
+static FRAGMENT alternation(void)
+{
+  FRAGMENT f = concatenation(), g, h;
+
+  while (*regex == '|') {
+    regex++;
+    g = concatenation();
+    h.entry = nfa_state();
+    h.exit = nfa_state();
+    epsilon(h.entry, f.entry);
+    epsilon(h.entry, g.entry);
+    epsilon(f.exit, h.exit);
+    epsilon(g.exit, h.exit);
+    f = h;
+  }
+  return f;
+}
+
+/* one NFA for all the rules, joined by a chain of epsilon forks */
+static int nfa_build(void)
+{
+  int start = nfa_state(), fork = start, i;
+  char reference[80];
+  FRAGMENT f;
+
+  for (i = 0; i < NRULES; i++) {
+    snprintf(reference, sizeof reference, "{%s}", rules[i].definition);
+    regex = regex_context = reference;
+    f = alternation();
+    if (*regex)
+      fatal("trailing characters", regex_context);
+    nfa_rule[f.exit] = i + 1;
+    epsilon(fork, f.entry);
+    if (i + 1 < NRULES) {
+      f.entry = nfa_state();
+      epsilon(fork, f.entry);
+      fork = f.entry;
+    }
+  }
+  return start;
+}
+
+/******************************** byte classes ********************************/
+
+/* bytes that no character set tells apart share one class */
+static int byte_class[256];
+static int nclasses = 0;
+
+static void classify(void)
+{
+  int c, d, s;
+
+  for (c = 0; c < 256; c++) {
+    byte_class[c] = -1;
+    for (d = 0; d < c; d++) {
+      for (s = 0; s < ncharsets && charsets[s][c] == charsets[s][d]; s++);
+      if (s == ncharsets) {
+        byte_class[c] = byte_class[d];
+        break;
+      }
+    }
+    if (byte_class[c] < 0)
+      byte_class[c] = nclasses++;
+  }
+}
+
+/**************************** subset construction *****************************/
+
+static unsigned char dfa_set[MAX_DFA_STATES][MAX_NFA_STATES];
+static int dfa_delta[MAX_DFA_STATES][256];
+static int dfa_rule[MAX_DFA_STATES];
+static int dfa_nstates = 0;
+
+static void eclose(unsigned char *set, int state)
+{
+  int i;
+
+  if (state < 0 || set[state])
+    return;
+  set[state] = 1;
+  if (nfa_charset[state] < 0) {
+    for (i = 0; i < 2; i++)
+      eclose(set, nfa_next[state][i]);
+  }
+}
+
+static int dfa_state(unsigned char const *set)
+{
+  int i, d;
+
+  for (d = 0; d < dfa_nstates; d++) {
+    if (memcmp(dfa_set[d], set, nfa_nstates) == 0)
+      return d;
+  }
+  if (dfa_nstates == MAX_DFA_STATES)
+    fatal("too many DFA states", "raise MAX_DFA_STATES");
+  memcpy(dfa_set[d], set, nfa_nstates);
+  dfa_rule[d] = 0;
+  for (i = 0; i < nfa_nstates; i++) {
+    if (set[i] && nfa_rule[i] && (dfa_rule[d] == 0 || nfa_rule[i] < dfa_rule[d]))
+      dfa_rule[d] = nfa_rule[i];
+  }
+  return dfa_nstates++;
+}
+
+/* state 0 is the dead state, state 1 the start state */
+static void subset(int nfa_start)
+{
+  unsigned char set[MAX_NFA_STATES];
+  int d, c, k, i;
+
+  memset(set, 0, sizeof set);
+  dfa_state(set);
+  eclose(set, nfa_start);
+  dfa_state(set);
+
+  for (d = 0; d < dfa_nstates; d++) {
+    for (k = 0; k < nclasses; k++) {
+      for (c = 0; byte_class[c] != k; c++);
+      memset(set, 0, sizeof set);
+      for (i = 0; i < nfa_nstates; i++) {
+        if (dfa_set[d][i] && nfa_charset[i] >= 0 && charsets[nfa_charset[i]][c])
+          eclose(set, nfa_next[i][0]);
+      }
+      dfa_delta[d][k] = dfa_state(set);
+    }
+  }
+}
+
+/******************************** minimization ********************************/
+
+static int block[MAX_DFA_STATES];
+static int nblocks;
+
+/* Moore: split blocks by the blocks of their successors until stable */
+static void minimize(void)
+{
+  static int next_block[MAX_DFA_STATES];
+  int d, e, k, n, changed;
+
+  for (d = 0; d < dfa_nstates; d++)
+    block[d] = dfa_rule[d];
+
+  do {
+    n = 0;
+    for (d = 0; d < dfa_nstates; d++) {
+      for (e = 0; e < d; e++) {
+        if (block[e] != block[d])
+          continue;
+        for (k = 0; k < nclasses && block[dfa_delta[e][k]] == block[dfa_delta[d][k]]; k++);
+        if (k == nclasses)
+          break;
+      }
+      next_block[d] = e < d ? next_block[e] : n++;
+    }
+    changed = 0;
+    for (d = 0; d < dfa_nstates; d++) {
+      changed |= next_block[d] != block[d];
+      block[d] = next_block[d];
+    }
+  } while (changed);
+
+  /* blocks are numbered in order of first member, so dead = 0 and start = 1 */
+  nblocks = n;
+}
+
+/******************************** keyword hash ********************************/
+
+#define KEYWORD(token, name) {#token, name},
+static struct {
+  char const *token;
+  char const *name;
+} reserved[] = {
+  KEYWORDS
+};
+#undef KEYWORD
+
+#define NRESERVED       (sizeof reserved / sizeof reserved[0])
+#define MAX_MULTIPLIER  64
+#define MAX_KEYWORD_TAB 0x400
+
+static int keyword_slot[MAX_KEYWORD_TAB]; // reserved word + 1, 0 if empty
+static int keyword_mlength, keyword_mfirst, keyword_mlast, keyword_size;
+
+static int keyword_try(void)
+{
+  int i, h, length;
+
+  memset(keyword_slot, 0, keyword_size * sizeof keyword_slot[0]);
+  for (i = 0; i < NRESERVED; i++) {
+    length = strlen(reserved[i].name);
+    h = KEYWORD_HASH(reserved[i].name[0], reserved[i].name[length - 1], length,
+      keyword_mlength, keyword_mfirst, keyword_mlast, keyword_size);
+    if (keyword_slot[h])
+      return 0;
+    keyword_slot[h] = i + 1;
+  }
+  return 1;
+}
+
+/* smallest power-of-two table first, then the smallest multipliers */
+static void keyword_hash(void)
+{
+  for (keyword_size = 1; keyword_size < NRESERVED; keyword_size *= 2);
+  for (; keyword_size <= MAX_KEYWORD_TAB; keyword_size *= 2) {
+    for (keyword_mlength = 1; keyword_mlength < MAX_MULTIPLIER; keyword_mlength++)
+      for (keyword_mfirst = 1; keyword_mfirst < MAX_MULTIPLIER; keyword_mfirst++)
+        for (keyword_mlast = 1; keyword_mlast < MAX_MULTIPLIER; keyword_mlast++)
+          if (keyword_try())
+            return;
+  }
+  fatal("no perfect hash for the keywords", "length, first and last characters collide");
+}
+
+/********************************** output ************************************/
+
+static FILE *output(char const *filename)
+{
+  FILE *file = fopen(filename, "w");
+
+  if (file == NULL)
+    fatal("cannot write", filename);
+  fprintf(file, "/**@<%s>::**/\n", filename);
+  fprintf(file, "/* generated by lexgen -- do not edit */\n\n");
+  return file;
+}
+
+// charclass: the CHAR_* bits of byte c, see charclass.h
+static int charclass(int c)
+{
+  int bits = 0;
+
+  if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+    bits |= CHAR_LETTER;
+  if (c >= '0' && c <= '9')
+    bits |= CHAR_DIGIT | CHAR_HEX;
+  if (c >= '0' && c <= '7')
+    bits |= CHAR_OCTAL;
+  if ((c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f'))
+    bits |= CHAR_HEX;
+  if (c == ' ' || (c >= '\t' && c <= '\r'))
+    bits |= CHAR_SPACE;
+  if (c && strchr(CHAR_OPERATORS, c))
+    bits |= CHAR_OPERATOR;
+  return bits;
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *header, *table;
+  int d, k, c, emitted;
+
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s lextab.h lextab.c\n", argv[0]);
+    return 1;
+  }
+
+  d = nfa_build();
+  classify();
+  subset(d);
+  minimize();
+  keyword_hash();
+
+  header = output(argv[1]);
+  fprintf(header, "#define LEXTAB_DEAD    0\n");
+  fprintf(header, "#define LEXTAB_START   1\n");
+  fprintf(header, "#define LEXTAB_STATES  %d\n", nblocks);
+  fprintf(header, "#define LEXTAB_CLASSES %d\n\n", nclasses);
+  fprintf(header, "extern unsigned char const lextab_class[256];\n");
+  fprintf(header, "extern unsigned char const lextab_fold[256];\n");
+  fprintf(header, "extern %s const lextab_delta[LEXTAB_STATES][LEXTAB_CLASSES];\n",
+    nblocks < 256 ? "unsigned char" : "unsigned short");
+  fprintf(header, "extern int const lextab_accept[LEXTAB_STATES];\n\n");
+  fprintf(header, "#define LEXTAB_KEYWORD_SIZE   %d\n", keyword_size);
+  fprintf(header, "#define LEXTAB_KEYWORD_LENGTH %d\n", keyword_mlength);
+  fprintf(header, "#define LEXTAB_KEYWORD_FIRST  %d\n", keyword_mfirst);
+  fprintf(header, "#define LEXTAB_KEYWORD_LAST   %d\n\n", keyword_mlast);
+  fprintf(header, "extern int const lextab_keyword[LEXTAB_KEYWORD_SIZE];\n");
+  fclose(header);
+
+  table = output(argv[2]);
+  fprintf(table, "#include <tokens.h>\n#include <keywords.h>\n#include <%s>\n\n", argv[1]);
+
+  fprintf(table, "unsigned char const lextab_class[256] = {");
+  for (c = 0; c < 256; c++)
+    fprintf(table, "%s%d,", c % 16 ? " " : "\n  ", byte_class[c]);
+  fprintf(table, "\n};\n\n");
+
+  fprintf(table, "unsigned char const lextab_charclass[256] = {");
+  for (c = 0; c < 256; c++)
+    fprintf(table, "%s%d,", c % 16 ? " " : "\n  ", charclass(c));
+  fprintf(table, "\n};\n\n");
+
+  // Pascal names are case-insensitive: everything that compares them folds through this
+  fprintf(table, "unsigned char const lextab_fold[256] = {");
+  for (c = 0; c < 256; c++)
+    fprintf(table, "%s%d,", c % 16 ? " " : "\n  ", c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+  fprintf(table, "\n};\n\n");
+
+  fprintf(table, "%s const lextab_delta[LEXTAB_STATES][LEXTAB_CLASSES] = {\n",
+    nblocks < 256 ? "unsigned char" : "unsigned short");
+  for (d = emitted = 0; d < dfa_nstates; d++) {
+    if (block[d] != emitted)
+      continue;
+    emitted++;
+    fprintf(table, "  {");
+    for (k = 0; k < nclasses; k++)
+      fprintf(table, "%s%d", k ? ", " : "", block[dfa_delta[d][k]]);
+    fprintf(table, "},\n");
+  }
+  fprintf(table, "};\n\n");
+
+  fprintf(table, "int const lextab_accept[LEXTAB_STATES] = {\n");
+  for (d = emitted = 0; d < dfa_nstates; d++) {
+    if (block[d] != emitted)
+      continue;
+    emitted++;
+    fprintf(table, "  %s,\n", dfa_rule[d] ? rules[dfa_rule[d] - 1].token : "0");
+  }
+  fprintf(table, "};\n\n");
+
+  fprintf(table, "int const lextab_keyword[LEXTAB_KEYWORD_SIZE] = {\n");
+  for (k = 0; k < keyword_size; k++)
+    fprintf(table, "  %s,\n", keyword_slot[k] ? reserved[keyword_slot[k] - 1].token : "0");
+  fprintf(table, "};\n");
+  fclose(table);
+
+  return 0;
+}
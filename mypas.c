@@ -3,62 +3,224 @@
 #include <tokens.h>
 #include <lexer.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <intern.h>
 #include <symtab.h>
 #include <mypas.h>
+#include <pseudoassembly.h>
+#include <parser.h>
 
-FILE *source, *object;
+/* the state of a compilation is thread-local (see also lexer.c, parser.c,
+symtab.c, intern.c and pseudoassembly.c): every thread runs its own */
+_Thread_local TAPE *source;
+_Thread_local char const *source_path; // as given on the command line, for diagnostics
+_Thread_local FILE *object;
+_Thread_local TOKBUF *tokens; // whole-file token buffer, only with --pretokenize or --parallel-lex
+_Thread_local TOKRING ring;   // tokens peeked at when lexing on demand
 
-int main (int argc, char *argv[], char *envp[])
+/* mypas_compile: compiles the program read from input (named path in
+diagnostics) into assembly on output,
+using only the calling thread's state, and leaves that state clean for the next
+compilation. pretokenize is 0 to lex on demand, 1 to lex the whole file before
+parsing and n > 1 to do so on n threads. Lexed on demand, a pipe is read
+through a bounded window instead of whole. Returns the number of semantic
+errors, or a negative error code */
+int mypas_compile(FILE *input, char const *path, FILE *output, int pretokenize)
 {
-  if (argc == 1) {
-    fprintf(stderr, "%s: cannot compile without an input file... exiting\n", argv[0]);
-    exit (FILE_NOT_FOUND);
-  } else if (argc == 2 || argc == 3) {
-
-    char *extension;
-    //getting extension (dividing argv[1] by '.'). Right one should be '.pas'
-    extension = strchr(argv[1], '.');
-    if(extension == NULL) {
-      fprintf(stderr, "%s: cannot open '%s'. File has no extension... exiting\n", argv[0], argv[1]);
-      exit (EMPTY_FILE_EXTENSION);
-    }
-    if(strcmp(extension, ".pas")) {
-      fprintf(stderr, "%s: cannot open '%s'. Extension '%s' is not compatible... exiting\n", argv[0], argv[1], extension);
-      exit (INCOMPATIBLE_FILE_EXTENSION);
+  int errors;
+
+  source_path = path;
+  source = pretokenize ? tape_open(input) : tape_stream(input, TAPE_WINDOW);
+  if (source == NULL)
+    return FILE_NOT_FOUND;
+  if (pretokenize && (tokens = pretokenize > 1 ? tokbuf_lex_parallel(source, pretokenize)
+                                               : tokbuf_lex(source)) == NULL) {
+    tape_close(source);
+    intern_reset();
+    return ALOCATION_ERR;
+  }
+  object = output;
+  tokring_init(&ring, source);
+
+  mypas();
+  //print_symtab_stream(); //this is a function for debug purposes, prints the entire symtab_stream
+  errors = ERROR_COUNTER;
+
+  tokbuf_free(tokens);
+  tokens = NULL;
+  tape_close(source);
+  source = NULL;
+  source_path = NULL;
+  symtab_reset();
+  intern_reset();
+  labelcounter = 1;
+  ERROR_COUNTER = 0;
+  return errors;
+}
+
+/* every .pas file on the command line is one job, and so is '-' for stdin; jobs are spread over
+worker threads, one per processor, and their stdout text is printed in
+command-line order once all of them are done */
+typedef struct {
+  char *path;
+  char *extension; // NULL for stdin
+  char *text;     // what the job wrote for stdout
+  size_t length;
+  int status;
+} JOB;
+
+static JOB *jobs;
+static int njobs = 0, nextjob = 0, assembly = 0, pretokenize = 0;
+static char *program;
+
+static void compile_job(JOB *job)
+{
+  FILE *input, *output;
+
+  if(assembly && job->extension != NULL){
+    //get filename
+    char filename[255];
+    int j;
+    for (j=0; j < strlen(job->path) - strlen(job->extension); j++){
+      filename[j] = job->path[j];
     }
+    filename[j] = '\0';
+    output = fopen(strcat(filename,".s"), "w+");
+  } else if (njobs == 1) {
+    output = stdout;
+  } else {
+    output = open_memstream(&job->text, &job->length);
+  }
 
-    //verify parameter -S to generate file
-    if( argc == 3){
-      //get filename
-      char filename[255];
-      int i;
-      for (i=0; i < strlen(argv[1]) - strlen(extension); i++){
-        filename[i] = argv[1][i];
-      }
-      filename[i] = '\0';
+  input = job->extension != NULL ? fopen(job->path, "r") : stdin;
+  job->status = mypas_compile(input, job->extension != NULL ? job->path : "<stdin>", output, pretokenize);
+  if (job->status == FILE_NOT_FOUND) {
+    fprintf (stderr, "%s: cannot open '%s'... exiting\n", program, job->path);
+  } else if (job->status == ALOCATION_ERR) {
+    fprintf (stderr, "%s: not enough memory to lex '%s'... exiting\n", program, job->path);
+  }
+  if (lex_stats) { // one block per file, even with several compiling at once
+    flockfile(stderr);
+    fprintf(stderr, "%s: lexer statistics\n", job->path);
+    lexstats_print(stderr);
+    funlockfile(stderr);
+    lexstats_reset();
+  }
+  if (input != NULL && input != stdin)
+    fclose(input);
+  if (output != NULL && output != stdout)
+    fclose(output);
+}
+
+static void *worker(void *unused)
+{
+  int i;
+
+  while ((i = __atomic_fetch_add(&nextjob, 1, __ATOMIC_RELAXED)) < njobs)
+    compile_job(&jobs[i]);
+  return NULL;
+}
+
+int main (int argc, char *argv[], char *envp[])
+{
+  char *extension;
+  int i, nworkers, status = END_OF_COMPILATION;
+  pthread_t *workers;
+
+  program = argv[0];
+  if ((jobs = calloc(argc, sizeof *jobs)) == NULL)
+    exit (ALOCATION_ERR);
+
+  for (i = 1; i < argc; i++) {
+
+    // verify if assembly code is asked ('-S' typed in terminal after .pas file)
+    if(strcmp(argv[i], "-S") == 0){
+      assembly = 1;
 
-      // verify if assembly code is asked ('-S' typed in terminal after .pas file)
-  	  if(strcmp(argv[2], "-S") == 0){
-  	     object = fopen(strcat(filename,".s"), "w+");
-  	  } else {
-  	   fprintf(stderr, "%s: cannot understand parameter '%s'... exiting\n",argv[0], argv[2]);
-  	   exit (INCOMPATIBLE_PARAMETER);
-  	  }
+    // choose the lexer implementation, hand-written recognizers by default
+    } else if(strcmp(argv[i], "--lexer=hand") == 0){
+      lexer_mode = HAND_LEXER;
+    } else if(strcmp(argv[i], "--lexer=dfa") == 0){
+      lexer_mode = DFA_LEXER;
+
+    // count and time every token the lexer hands out, reported on stderr
+    } else if(strcmp(argv[i], "--lex-stats") == 0){
+      lex_stats = 1;
+
+    // lex the whole file before parsing starts
+    } else if(strcmp(argv[i], "--pretokenize") == 0){
+      pretokenize = 1;
+
+    // lex the whole file up front, split among one thread per processor (per job's share of them)
+    } else if(strcmp(argv[i], "--parallel-lex") == 0){
+      pretokenize = sysconf(_SC_NPROCESSORS_ONLN);
+      if (pretokenize < 1)
+        pretokenize = 1;
+
+    // read the source from stdin, streamed unless it is to be pretokenized
+    } else if(strcmp(argv[i], "-") == 0){
+      jobs[njobs].path = argv[i];
+      jobs[njobs].extension = NULL;
+      njobs++;
+
+    } else if(argv[i][0] == '-'){
+      fprintf(stderr, "%s: cannot understand parameter '%s'... exiting\n",argv[0], argv[i]);
+      exit (INCOMPATIBLE_PARAMETER);
 
     } else {
-      object = stdout;
+      //getting extension (dividing the name by '.'). Right one should be '.pas'
+      extension = strchr(argv[i], '.');
+      if(extension == NULL) {
+        fprintf(stderr, "%s: cannot open '%s'. File has no extension... exiting\n", argv[0], argv[i]);
+        exit (EMPTY_FILE_EXTENSION);
+      }
+      if(strcmp(extension, ".pas")) {
+        fprintf(stderr, "%s: cannot open '%s'. Extension '%s' is not compatible... exiting\n", argv[0], argv[i], extension);
+        exit (INCOMPATIBLE_FILE_EXTENSION);
+      }
+      jobs[njobs].path = argv[i];
+      jobs[njobs].extension = extension;
+      njobs++;
     }
+  }
+
+  if (njobs == 0) {
+    fprintf(stderr, "%s: cannot compile without an input file... exiting\n", argv[0]);
+    exit (FILE_NOT_FOUND);
+  }
 
-    source = fopen(argv[1], "r");
+  nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+  if (nworkers > njobs)
+    nworkers = njobs;
+  // jobs that lex in parallel share the processors instead of each taking all of them
+  if (pretokenize > 1 && nworkers > 1) {
+    pretokenize /= nworkers;
+    if (pretokenize < 1)
+      pretokenize = 1;
+  }
+  if (nworkers <= 1 || (workers = calloc(nworkers, sizeof *workers)) == NULL) {
+    worker(NULL);
   } else {
-    source = fopen (argv[1], "r");
-    if (source == NULL) {
-      fprintf (stderr, "%s: cannot open '%s'... exiting\n", argv[0], argv[1]);
-      exit (PARAMETERS_SURPLUS);
+    for (i = 0; i < nworkers; i++) {
+      if (pthread_create(&workers[i], NULL, worker, NULL))
+        break;
     }
+    if (i == 0)
+      worker(NULL);
+    while (i-- > 0)
+      pthread_join(workers[i], NULL);
+    free(workers);
+  }
+
+  for (i = 0; i < njobs; i++) {
+    if (jobs[i].text != NULL) {
+      fwrite(jobs[i].text, 1, jobs[i].length, stdout);
+      free(jobs[i].text);
+    }
+    if (jobs[i].status < 0 && status == END_OF_COMPILATION)
+      status = jobs[i].status;
   }
-  mypas();
-  //print_symtab_stream(); //this is a function for debug purposes, prints the entire symtab_stream
   printf("\n");
-  exit (END_OF_COMPILATION);
+  exit (status);
 }
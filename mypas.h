@@ -1,7 +1,15 @@
 #include <stdio.h>
+#include <tape.h>
+#include <tokbuf.h>
 
-FILE *source, *object;
+extern _Thread_local TAPE *source;
+extern _Thread_local char const *source_path;
+extern _Thread_local FILE *object;
+extern _Thread_local TOKBUF *tokens;
+extern _Thread_local TOKRING ring;
 
-extern int gettoken(FILE *);
+extern int gettoken(TAPE *);
 extern void mypas(void);
-extern int lookahead;
+extern _Thread_local int lookahead;
+
+extern int mypas_compile(FILE *input, char const *path, FILE *output, int pretokenize);
@@ -44,15 +44,18 @@
 #include <tokens.h>
 #include <lexer.h>
 #include <keywords.h>
+#include <intern.h>
 #include <symtab.h>
 #include <mypas.h>
 #include <macros.h>
 #include <pseudoassembly.h>
+#include <storage.h>
+#include <alloc.h>
 #include <parser.h>
 
-int ERROR_COUNTER = 0; // semantic errors counter
+_Thread_local int ERROR_COUNTER = 0; // semantic errors counter
 
-char **namelist(void);
+uint32_t *namelist(void);
 
 /* function to increment semantic error counter (ERROR_COUNTER) and print
 error number in error file (via fprintf) */
@@ -62,6 +65,32 @@ int semanticErrorNum()
   return ERROR_COUNTER;
 }
 
+/* where: "path:line:column" of the lookahead token, for diagnostics, which
+name their file as several may be compiling at once. Tokens only know
+their byte offset; the tape maps it to a line on demand */
+char const *where(void)
+{
+  return where_at(tokens ? tokbuf_offset(tokens, tokens->current) : ring.offset);
+}
+
+// where_at: "path:line:column" of the byte at offset in the source
+char const *where_at(size_t offset)
+{
+  int line, column;
+
+  tape_position(source, offset, &line, &column);
+  return where_line(line, column);
+}
+
+// where_line: "path:line:column" of a position the lexer worked out itself
+char const *where_line(int line, int column)
+{
+  static _Thread_local char position[FILENAME_MAX + 32];
+
+  snprintf(position, sizeof position, "%s:%d:%d", source_path, line, column);
+  return position;
+}
+
 /*
 *
 * mypas -> prgbody '.'
@@ -78,7 +107,7 @@ int semanticErrorNum()
 *
 * namelist -> ID { , ID }
 *
-* vartype -> INTEGER | REAL | BOOLEAN
+* vartype -> INTEGER | REAL | DOUBLE | BOOLEAN
 *
 * fnctype -> INTEGER | REAL | BOOLEAN
 *
@@ -96,9 +125,10 @@ int semanticErrorNum()
 // mypas -> prgbody '.'
 void mypas(void)
 {
-  lookahead = gettoken (source);
+  lookahead = nexttoken ();
   body();
   match('.');
+  /*[[*/ storage_layout(); // the globals, now that all of them are known /*]]*/
 }
 
 // prgbody -> declarative imperative
@@ -116,17 +146,16 @@ void declarative(void)
     do {
       /*[[*/ int type , i /*]]*/;
       // get the names of the declared variables
-      /*[[*/ char **namev = /*]]*/ namelist();
+      /*[[*/ uint32_t *namev = /*]]*/ namelist();
       match(':');
       // get the type of the declared variables
       /*[[*/ type =  /*]]*/ vartype();
 
       // insert name values and types of the variables in the symtab
       /*[[*/
-      for(i=0; namev[i]; i++) {
-        if(symtab_append(namev[i], type) == -2)
-          fprintf(stderr,"%d: FATAL ERROR -2: no more space in symtab", semanticErrorNum());
-      }
+      for(i=0; namev[i]; i++)
+        symtab_append(namev[i], type);
+      free(namev);
       /*]]*/
       match(';');
     } while(lookahead == ID);
@@ -135,24 +164,31 @@ void declarative(void)
 }
 
 //namelist -> ID { , ID }
-// array of symbols (symbolvec) with names of variables (IDs)
-char **namelist(void)
+// array of symbols (symbolvec) with the interned names of variables (IDs), 0-terminated
+uint32_t *namelist(void)
 {
-  /*[[*/ char **symbolvec = (char **)calloc(MAX_ARG_NUM, sizeof(char **)); /*]]*/
-  /*[[*/ int i = 0; /*]]*/
+  /*[[*/ uint32_t *symbolvec = NULL; /*]]*/
+  /*[[*/ int i = 0, capacity = 0; /*]]*/
 
   _namelist_begin:
-  /*[[*/ strcpy(symbolvec[i] = malloc(sizeof lexeme +1), lexeme); i++; /*]]*/
+  /*[[*/
+  if(i + 1 >= capacity) { // keep room for the 0 that closes the list
+    capacity = capacity ? 2 * capacity : MAX_ARG_NUM;
+    symbolvec = alloc_grow(symbolvec, capacity, sizeof *symbolvec, "parser");
+  }
+  symbolvec[i++] = lexval.id;
+  /*]]*/
   match(ID);
   while(lookahead == ',') {
     match(',');
     goto _namelist_begin;
   }
+  /*[[*/ symbolvec[i] = 0; /*]]*/
 
   /*[[*/ return symbolvec /*]]*/;
 }
 
-// vartype -> INTEGER | REAL | BOOLEAN
+// vartype -> INTEGER | REAL | DOUBLE | BOOLEAN
 int vartype(void)
 {
   switch(lookahead) {
@@ -164,6 +200,10 @@ int vartype(void)
       match(REAL);
       return REAL;
 
+    case DOUBLE:
+      match(DOUBLE);
+      return DOUBLE;
+
     default:
       match(BOOLEAN);
       return BOOLEAN;
@@ -217,7 +257,10 @@ void stmt(void)
     /*hereafter we expect FIRST(smpexpr):*/
     case ID: //tokens.h
     case FLTCONST: //tokens.h
+    case DBLCONST: //tokens.h
     case INTCONST: //tokens.h
+    case OCTAL: //tokens.h
+    case HEX: //tokens.h
     case TRUE: //keywords.h
     case FALSE: //keywords.h
     case NOT: //keywords.h
@@ -251,14 +294,13 @@ void ifstmt(void)
   match(IF);
   expr(BOOLEAN);
   // syntype = expr(BOOLEAN); //-> <expr>asm
-  /*[[*/fprintf(object, "\tjz .L%d\n", _endif = _else = labelcounter++);/*]]*/
+  /*[[*/gofalse(_endif = _else = labelcounter++);/*]]*/
   match(THEN);
   stmt();
   if(lookahead == ELSE) {
     match(ELSE);
     /*[[*/_endif = jump(labelcounter++);/*]]*/
     /*[[*/mklabel(_else);/*]]*/
-    /*[[*/mklabel(_endif);/*]]*/
     stmt();
   }
   /*[[*/mklabel(_endif);/*]]*/
@@ -283,7 +325,9 @@ void whilestmt(void)
 //repeatstmt -> REPEAT stmt { ; stmt } UNTIL smpexpr
 void repeatstmt(void)
 {
+  /*[[*/int repeat_head;/*]]*/
   match(REPEAT);
+  /*[[*/mklabel(repeat_head = labelcounter++);/*]]*/
   stmt();
   while(lookahead == ';') {
     match(';');
@@ -291,6 +335,7 @@ void repeatstmt(void)
   }
   match(UNTIL);
   expr(BOOLEAN);
+  /*[[*/gofalse(repeat_head);/*]]*/
 }
 
 /* smpexpr -> term { addop [[<enter>]] term [[ print addop.pf ]] } */
@@ -356,32 +401,32 @@ void repeatstmt(void)
    return 0;
  }
 
+// condition: the setcc suffix a relational operator compares with
+static char const *condition(int relop)
+{
+  switch(relop) {
+    case '<': return "l";
+    case '>': return "g";
+    case '=': return "e";
+    case GEQ: return "ge";
+    case LEQ: return "le";
+    default: return "ne"; // NEQ
+  }
+}
+
 int isrelop(void)
 {
+  int relop = lookahead;
+
   switch(lookahead) {
     case '>':
-      match('>');
-      if(lookahead == '=') {
-	       match('=');
-         return GEQ; //greater or equal
-      }
-      return '>';
-
     case '<':
-      match('<');
-      if(lookahead == '>') {
-	       match('>');
-         return NEQ; //not equal
-      }
-      if(lookahead == '=') {
-	       match('=');
-         return LEQ; //less or equal
-      }
-      return '<';
-
     case '=':
-      match('=');
-      return '=';
+    case GEQ: //greater or equal
+    case LEQ: //less or equal
+    case NEQ: //not equal
+      match(relop);
+      return relop;
   }
   return 0;
 }
@@ -389,18 +434,19 @@ int isrelop(void)
 /* syntax: expr -> smpexpr [ relop smpexpr ] */
 int expr(int inherited_type)
 {
-  int t1;
+  int t1, relop;
   t1 = smpexpr(0); // t1 is for the right side of the smpexpression
   int t2 = 0;
 
 
-  if(isrelop()) { // verifies only when it comes a relational operator
+  if((relop = isrelop())) { // verifies only when it comes a relational operator
+     /*[[*/pushacc();/*]]*/
      t2 = smpexpr(t1);
 
     if(iscompatible(t1,t2)) {
-      //	cmpl();
+      /*[[*/cmpint(condition(relop));/*]]*/
     } else {
-       fprintf(stderr, "%d: incompatible operation %d with %d: fatal error.\n",semanticErrorNum(),t1,t2);
+       fprintf(stderr, "%s: %d: incompatible operation %d with %d: fatal error.\n",where(), semanticErrorNum(),t1,t2);
        return -1;
     }
   }
@@ -410,7 +456,7 @@ int expr(int inherited_type)
       return BOOLEAN;
     } else {
      if((inherited_type == BOOLEAN && t1 > BOOLEAN) || (t1 == BOOLEAN && inherited_type > BOOLEAN)){
-       fprintf(stderr, "%d: incompatible operation %d with %d: fatal error.\n",semanticErrorNum(),t1,t2);
+       fprintf(stderr, "%s: %d: incompatible operation %d with %d: fatal error.\n",where(), semanticErrorNum(),t1,t2);
        return -1;
      } else {
       return max(t1,inherited_type);
@@ -431,22 +477,25 @@ int smpexpr(int inherited_type)
 	acctype = inherited_type,// accumulated type [after]
 	syntype,                 // symbol type declared in symtab [before]
 	ltype,           // syntype but for later compatibility verification [before]
-	rtype/*]]*/;     // updated type (with or without promotion) [after]
+	rtype,           // updated type (with or without promotion) [after]
+	negate = 0/*]]*/;// '-' or NOT before the first term, applied once it is done
 
   if(lookahead == '-'){
     match('-');
+    /*[[*/negate = '-';/*]]*/
     /*[[*/
     if(acctype == BOOLEAN) { // "minus" isn't compatible with boolean operation
-      fprintf(stderr, "%d: incompatible unary operator: fatal error.\n",semanticErrorNum());
+      fprintf(stderr, "%s: %d: incompatible unary operator: fatal error.\n",where(), semanticErrorNum());
     } else if (acctype == 0) {
       acctype = INTEGER;
     }
     /*]]*/
   } else if (lookahead == NOT) {
     match(NOT);
+    /*[[*/negate = NOT;/*]]*/
     /*[[*/
     if(acctype > BOOLEAN) { // "not" isn't compatible with non-boolean operation
-      fprintf(stderr, "%d: incompatible unary operator: fatal error.\n", semanticErrorNum());
+      fprintf(stderr, "%s: %d: incompatible unary operator: fatal error.\n", where(), semanticErrorNum());
     }
     acctype = BOOLEAN;
     /*]]*/
@@ -458,12 +507,12 @@ int smpexpr(int inherited_type)
 
       case ID:
         /*[[*/
-        varlocality = symtab_lookup(lexeme);
+        varlocality = symtab_lookup(lexval.id);
         if(varlocality < 0) {
-          fprintf(stderr, "%d: parser: %s not declared... fatal error!\n", semanticErrorNum(),lexeme);
+          fprintf(stderr, "%s: %d: parser: %s not declared... fatal error!\n", where(), semanticErrorNum(),intern_name(lexval.id));
 	        syntype = -1;
         } else {
-	        syntype = symtab[varlocality][1];
+	        syntype = symtab_entry(varlocality)->type;
 	      }
         /*]]*/
 	if (acctype == 0){
@@ -487,18 +536,19 @@ int smpexpr(int inherited_type)
 	    }
 	    /*]]*/
 	} /*[[*/ else if(varlocality > -1) {
-          fprintf(object, "\tpushl %%eax\n\tmovl %s,%%eax\n",
-            symtab_stream + symtab[varlocality][0]);
+          if(storage_size(syntype) == 8)
+            rmoveq(intern_name(symtab_entry(varlocality)->name));
+          else
+            rmovel(intern_name(symtab_entry(varlocality)->name));
         }
         /*]]*/
         break;
 
       case FLTCONST:
         {
-          float lexval = atof(lexeme);
-          char *fltIEEE = malloc(sizeof(lexeme) + 1);
-          /*[[*/sprintf(fltIEEE, "$%i", ((int *)&lexval) );/*]]*/
-          /*[[*/rmovel(fltIEEE);/*]]*/
+          /*[[*/float fltval = lexval.real;/*]]*/
+          /*[[*/int32_t fltIEEE; memcpy(&fltIEEE, &fltval, sizeof fltIEEE);/*]]*/
+          /*[[*/rmovel_imm(fltIEEE);/*]]*/
         }
         match(FLTCONST);
 	syntype = REAL;
@@ -507,9 +557,29 @@ int smpexpr(int inherited_type)
 	}
         break;
 
+      case DBLCONST:
+        {
+          /*[[*/int64_t dblIEEE; memcpy(&dblIEEE, &lexval.real, sizeof dblIEEE);/*]]*/
+          /*[[*/rmoveq_imm(dblIEEE);/*]]*/
+        }
+        match(DBLCONST);
+	syntype = DOUBLE;
+	if (acctype > BOOLEAN || acctype == 0) {
+	    acctype = max(acctype, syntype);
+	}
+        break;
+
+      case OCTAL:
+      case HEX:
       case INTCONST:
-	     /*[[*/rmovel((char*)lexeme);/*]]*/
-        match(INTCONST);
+	     /*[[*/
+        // integer is 32 bits: a literal beyond it is an error, not a wrapped value
+        if(lexval.integer > INT32_MAX)
+          fprintf(stderr, "%s: %d: parser: integer constant %lld out of range\n", where(), semanticErrorNum(), (long long) lexval.integer);
+        else
+          rmovel_imm(lexval.integer);
+        /*]]*/
+        match(lookahead);
 	syntype = INTEGER;
 	if (acctype > BOOLEAN || acctype == 0) {
 	    acctype = max(acctype, syntype);
@@ -525,24 +595,39 @@ int smpexpr(int inherited_type)
 	      if(iscompatible(syntype, acctype)) {
 	         acctype = max(acctype,syntype);
 	      } else {
-		 printf("default");
-	         fprintf(stderr, "%d: incompatible unary operator: fatal error.\n", semanticErrorNum());
+	         fprintf(stderr, "%s: %d: incompatible unary operator: fatal error.\n", where(), semanticErrorNum());
 		 acctype = -1;
 	      }
 	      /*]]*/
         match(')');
     }
 
-     if(mul_flag){
-       mulint();
+    /*[[*/
+    // the operators pushed their left operand; the right one is in the accumulator
+    switch(mul_flag) {
+      case '*': mulint(); break;
+      case '/': divint(); break;
+      case AND: mullog(); break;
     }
+    /*]]*/
 
     if(mul_flag = mulop())
       goto F_entry;
 
-    if(add_flag){
-       addint();
+    /*[[*/
+    if(negate) { // the first term is complete
+      if(negate == NOT)
+        neglog();
+      else
+        negint();
+      negate = 0;
     }
+    switch(add_flag) {
+      case '+': addint(); break;
+      case '-': subint(); break;
+      case OR: addlog(); break;
+    }
+    /*]]*/
 
     if(add_flag = addop())
       goto T_entry;
@@ -553,11 +638,11 @@ int smpexpr(int inherited_type)
       switch(ltype) {
         // verify which kind of instructions will be worked
         case INTEGER: case REAL: case BOOLEAN:
-          lmovel(symtab_stream + symtab[varlocality][0]); // when 32-bit operation
+          lmovel(intern_name(symtab_entry(varlocality)->name)); // when 32-bit operation
           break;
 
         case DOUBLE:
-          lmoveq(symtab_stream + symtab[varlocality][0]); // when 64-bit operation
+          lmoveq(intern_name(symtab_entry(varlocality)->name)); // when 64-bit operation
           break;
 
         default: //case  BOOLEAN
@@ -576,17 +661,17 @@ int addop (void)
   {
     case '+':
       match('+');
-      /*[[*/addint();/*]]*/
+      /*[[*/pushacc();/*]]*/
       return '+';
 
     case '-':
       match('-');
-      /*[[*/subint();/*]]*/
+      /*[[*/pushacc();/*]]*/
       return '-';
 
     case OR:
       match(OR);
-      /*[[*/mullog();/*]]*/
+      /*[[*/pushacc();/*]]*/
       return OR;
   }
   return 0;
@@ -599,17 +684,17 @@ int mulop (void)
   {
     case '*':
       match('*');
-      /*[[*/mulint();/*]]*/
+      /*[[*/pushacc();/*]]*/
       return '*';
 
     case '/':
       match('/');
-      /*[[*/divint();/*]]*/
+      /*[[*/pushacc();/*]]*/
       return '/';
 
     case AND:
       match(AND);
-      /*[[*/addlog();/*]]*/
+      /*[[*/pushacc();/*]]*/
       return AND;
   }
   return 0;
@@ -617,16 +702,31 @@ int mulop (void)
 
 /******************************* lexer-to-parser interface *****************************************/
 
-int lookahead;
+_Thread_local int lookahead;
+
+// nexttoken: next token from the token buffer when the source was lexed up front,
+// from the lookahead ring (straight from the tape unless peeked at) otherwise
+int nexttoken (void)
+{
+  int token = tokens ? tokbuf_advance (tokens) : tokring_advance (&ring);
+
+  // the lexer stops at a comment left open: the rest of the source is in it
+  if (token == UNTERMINATED) {
+    fprintf (stderr, "%s: %d: lexer: unterminated comment\n",
+      where_line (lexval.opening.line, lexval.opening.column), semanticErrorNum ());
+    token = tokens ? tokbuf_advance (tokens) : tokring_advance (&ring);
+  }
+  return token;
+}
 
 void match (int expected_token)
 {
   if (expected_token == lookahead) {
-    lookahead = gettoken (source);
+    lookahead = nexttoken ();
   } else {
     fprintf (stderr, "\nparser: token mismatch error.\n");
-    fprintf (stderr, "expecting %d but seen %d. Exting...\n",
-    expected_token, lookahead);
+    fprintf (stderr, "%s: expecting %d but seen %d. Exting...\n",
+    where(), expected_token, lookahead);
     //exit (SYNTAX_ERR);
     fprintf(stderr,"FATAL ERROR %d",SYNTAX_ERR);
     return;
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <lexer.h>
+#include <tokbuf.h>
 /********************************** Recursive LL(1) Pareser *****************************************
  *
  * Method: assign nonterminal symbols to C-function names
@@ -68,12 +69,26 @@ void repeatstmt(void);
 
 /******************************* lexer-to-parser interface *****************************************/
 
-extern int lookahead; /** @ parser.c **/
+extern _Thread_local int lookahead; /** @ parser.c **/
 
-extern int gettoken (FILE *); /** @ lexer.c **/
+extern _Thread_local int ERROR_COUNTER; /** @ parser.c **/
+
+extern int gettoken (TAPE *); /** @ lexer.c **/
+
+int nexttoken (void);
 
 void match (int expected_token);
 
-extern FILE *source;
+char const *where (void);
+char const *where_at (size_t offset);
+char const *where_line (int line, int column);
+
+extern _Thread_local TAPE *source;
+
+extern _Thread_local char const *source_path;
+
+extern _Thread_local TOKBUF *tokens;
+
+extern _Thread_local TOKRING ring;
 
-extern char lexeme[]; /** @ lexer.c **/
+extern _Thread_local char lexeme[]; /** @ lexer.c **/
@@ -1,13 +1,15 @@
+#include <stdint.h>
 #include <pseudoassembly.h>
 
 /*unified label counter*/
 
-int labelcounter = 1;
+_Thread_local int labelcounter = 1;
 
 /*control pseudo instructions*/
 
-int gofalse(int label)
+int gofalse(int label) // on a false (0) accumulator
 {
+  fprintf(object, "\ttestl %%eax, %%eax\n");
   fprintf(object, "\tjz .L%d\n", label);
   return label;
 }
@@ -24,7 +26,7 @@ int jle(int label){
 }
 
 int jlt(int label){
-  fprintf(object, "\tjlt .L%d\n", label);
+  fprintf(object, "\tjl .L%d\n", label);
   return 0;
 }
 
@@ -34,12 +36,12 @@ int jge(int label){
 }
 
 int jgt(int label){
-  fprintf(object, "\tjgt .L%d\n", label);
+  fprintf(object, "\tjg .L%d\n", label);
   return 0;
 }
 
 int jeq(int label){
-  fprintf(object, "\tjeq .L%d\n", label);
+  fprintf(object, "\tje .L%d\n", label);
   return 0;
 }
 
@@ -48,39 +50,71 @@ int jne(int label){
   return 0;
 }
 
-int cmpl() {
-  fprintf(object, "\tcmpl (%%esp), %%eax\n");
+/* relational operators: compare the left operand, popped from the stack,
+with the accumulator and leave 1 or 0 in %eax; condition is the setcc
+suffix of the operator (l, le, e, ne, ge, g) */
+int cmpint(char const *condition)
+{
+  fprintf(object, "\tpopq %%rcx\n");
+  fprintf(object, "\tcmpl %%eax, %%ecx\n");
+  fprintf(object, "\tset%s %%al\n", condition);
+  fprintf(object, "\tmovzbl %%al, %%eax\n");
+  return 0;
 }
 
 int mklabel(int label)
 {
-  fprintf(object, ".L%d\n", label);
+  fprintf(object, ".L%d:\n", label);
   return label;
 }
 
+/* variables are addressed relative to the instruction pointer, as the
+linker places .bss anywhere in the address space. The accumulator is
+%eax, or %rax for 64-bit values. Loading it does not save what it held:
+a binary operator pushes its left operand (pushacc) before the right one
+is loaded and pops it again, always as a whole 8-byte slot since x86-64
+has no 32-bit push or pop, so every expression leaves the stack as it
+found it */
+
+int pushacc (void) // the accumulator becomes the left operand of an operator
+{
+  fprintf(object, "\tpushq %%rax\n");
+  return 0;
+}
+
 int lmovel (char const *variable) // copy of 32 bits
 {
-  fprintf(object, "\tmovl %%eax,%s\n",variable);
+  fprintf(object, "\tmovl %%eax,%s(%%rip)\n",variable);
   return 0;
 }
 
 int lmoveq (char const *variable) // copy of 64 bits
 {
-  fprintf(object, "\tmovq %%rax,%s\n",variable);
+  fprintf(object, "\tmovq %%rax,%s(%%rip)\n",variable);
   return 0;
 }
 
 int rmovel (char const *variable) // copy of 32 bits
 {
-  fprintf(object, "\tpushl %%eax\n");
-  fprintf(object, "\tmovl %s, %%eax\n",variable);
+  fprintf(object, "\tmovl %s(%%rip), %%eax\n",variable);
   return 0;
 }
 
 int rmoveq (char const *variable) // copy of 64 bits
 {
-  fprintf(object, "\tpushl %%rax\n");
-  fprintf(object, "\tmovq %s, %%rax\n",variable);
+  fprintf(object, "\tmovq %s(%%rip), %%rax\n",variable);
+  return 0;
+}
+
+int rmovel_imm (int32_t constant) // 32-bit immediate: integer or float bits
+{
+  fprintf(object, "\tmovl $%d, %%eax\n", constant);
+  return 0;
+}
+
+int rmoveq_imm (int64_t constant) // 64-bit immediate: long or double bits
+{
+  fprintf(object, "\tmovabsq $%lld, %%rax\n", (long long) constant);
   return 0;
 }
 
@@ -88,105 +122,97 @@ int rmoveq (char const *variable) // copy of 64 bits
 
 /*unary*/
 
-int neglog(void)
+int neglog(void) // booleans are 0 or 1
 {
-  fprintf(object, "\tnot %%eax\n");
+  fprintf(object, "\txorl $1, %%eax\n");
   return 0;
 }
 
 int negint(void)
 {
-  fprintf(object, "\tnot %%eax\n");
+  fprintf(object, "\tnegl %%eax\n");
   return 0;
 }
 
-int negflt(void)
+int negflt(void) // flips the sign bit of the float in %eax
 {
-  fprintf(object, "\taddss %%xmm1, %%xmm0\n");
-  fprintf(object, "\tmovss %%xmm0, x(%%rip)\n");
-  fprintf(object, "\tnot %%esp\n");
+  fprintf(object, "\txorl $0x80000000, %%eax\n");
   return 0;
 }
 
-int negdbl(void)
+int negdbl(void) // flips the sign bit of the double in %rax
 {
-  fprintf(object, "\taddsd %%xmm1, %%xmm0\n");
-  fprintf(object, "\tmovsd %%xmm0, x(%%rip)\n");
-  fprintf(object, "\tnot %%esp\n");
+  fprintf(object, "\tbtcq $63, %%rax\n");
   return 0;
 }
 
 /*binary addition and inversion*/
 
-/*dbl and flt functions expects the value in the last label
-then move the value from the label to register
-then apply operation (value on register with value on top of stack)
-  int functions expects value in register then just apply operation
+/*the left operand is the slot on top of the stack, the right one is in
+the accumulator; the result goes to the accumulator and the slot is popped.
+int and log functions work on %eax directly, flt and dbl ones move the
+operands through %xmm0 (left) and %xmm1 (right)
 */
 
 int addlog(void)
 {
-  fprintf(object, "\tor %%eax, (%%esp)\n");
-  fprintf(object, "\tpopl %%eax\n");
+  fprintf(object, "\tpopq %%rcx\n");
+  fprintf(object, "\torl %%ecx, %%eax\n");
   return 0;
 }
 
 int addint(void)
 {
-  fprintf(object, "\tmovl (%%rsp), %%ebx\n");
-  fprintf(object, "\tmovl %%rax, %%eax\n");  
-  fprintf(object, "\taddl %%eax, (%%esp)\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
- return 0;
+  fprintf(object, "\tpopq %%rcx\n");
+  fprintf(object, "\taddl %%ecx, %%eax\n");
+  return 0;
 }
 
 int addflt(void)
 {
+  fprintf(object, "\tmovd %%eax, %%xmm1\n");
   fprintf(object, "\tmovss (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovss %%rax, %%xmm1\n");
   fprintf(object, "\taddss %%xmm1, %%xmm0\n");
-  fprintf(object, "\tmovss %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tmovd %%xmm0, %%eax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
 }
 
 int adddbl(void)
 {
+  fprintf(object, "\tmovq %%rax, %%xmm1\n");
   fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n");
-  fprintf(object, "\tmulsd %%rbp, %%xmm0\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\taddsd %%xmm1, %%xmm0\n");
+  fprintf(object, "\tmovq %%xmm0, %%rax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
 }
 
 int subint(void)
 {
-  fprintf(object, "\tmovl (%%rsp), %%ebx\n");
-  fprintf(object, "\tmovl %%rax, %%eax\n");  
-  fprintf(object, "\tsubl %%esp,%%eax\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tmovl %%eax, %%ecx\n");
+  fprintf(object, "\tpopq %%rax\n");
+  fprintf(object, "\tsubl %%ecx, %%eax\n");
   return 0;
 }
 
 int subflt(void)
 {
-  fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n"); 
-  fprintf(object, "\tsubss %%rbp, %%xmm0\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tmovd %%eax, %%xmm1\n");
+  fprintf(object, "\tmovss (%%rsp), %%xmm0\n");
+  fprintf(object, "\tsubss %%xmm1, %%xmm0\n");
+  fprintf(object, "\tmovd %%xmm0, %%eax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
 }
+
 int subdbl(void)
 {
+  fprintf(object, "\tmovq %%rax, %%xmm1\n");
   fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n");  
-  fprintf(object, "\tsubsd %%rbp, %%xmm0\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tsubsd %%xmm1, %%xmm0\n");
+  fprintf(object, "\tmovq %%xmm0, %%rax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
 }
 
@@ -194,69 +220,63 @@ int subdbl(void)
 
 int mullog(void)
 {
-  fprintf(object, "\tand %%eax, (%%esp)\n");
-  fprintf(object, "\tpopl %%eax\n");
+  fprintf(object, "\tpopq %%rcx\n");
+  fprintf(object, "\tandl %%ecx, %%eax\n");
   return 0;
 }
 
 int mulint(void)
 {
-  fprintf(object, "\tmovl (%%rsp), %%ebx\n");
-  fprintf(object, "\tmovl %%rax, %%eax\n");  
-  fprintf(object, "\timull %%esp, %%eax\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tpopq %%rcx\n");
+  fprintf(object, "\timull %%ecx, %%eax\n");
   return 0;
 }
 
 int mulflt(void)
 {
-  fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n");  
-  fprintf(object, "\tmulss %%rbp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tmovd %%eax, %%xmm1\n");
+  fprintf(object, "\tmovss (%%rsp), %%xmm0\n");
+  fprintf(object, "\tmulss %%xmm1, %%xmm0\n");
+  fprintf(object, "\tmovd %%xmm0, %%eax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
 }
 
 int muldbl(void)
 {
+  fprintf(object, "\tmovq %%rax, %%xmm1\n");
   fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n");  
-  fprintf(object, "\tmulsd %%rbp, %%xmm0\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
- 
+  fprintf(object, "\tmulsd %%xmm1, %%xmm0\n");
+  fprintf(object, "\tmovq %%xmm0, %%rax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
 }
 
 int divint(void)
 {
-  fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n");  
+  fprintf(object, "\tmovl %%eax, %%ecx\n");
+  fprintf(object, "\tpopq %%rax\n");
   fprintf(object, "\tcltd\n");
-  fprintf(object, "\tidivl %%rbp\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tidivl %%ecx\n");
   return 0;
 }
 
 int divflt(void)
 {
-  fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n");  
-  fprintf(object, "\tdivss %%rbp, %%xmm0;\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tmovd %%eax, %%xmm1\n");
+  fprintf(object, "\tmovss (%%rsp), %%xmm0\n");
+  fprintf(object, "\tdivss %%xmm1, %%xmm0\n");
+  fprintf(object, "\tmovd %%xmm0, %%eax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
 }
 
 int divdbl(void)
 {
+  fprintf(object, "\tmovq %%rax, %%xmm1\n");
   fprintf(object, "\tmovsd (%%rsp), %%xmm0\n");
-  fprintf(object, "\tmovsd %%rax, %%xmm1\n");  
-  fprintf(object, "\tdivss %%rbp), %%xmm0;\n");
-  fprintf(object, "\tmovsd %%xmm0, %%rax\n");
-  fprintf(object, "\taddq $8,%%rsp\n");
+  fprintf(object, "\tdivsd %%xmm1, %%xmm0\n");
+  fprintf(object, "\tmovq %%xmm0, %%rax\n");
+  fprintf(object, "\taddq $8, %%rsp\n");
   return 0;
-}
\ No newline at end of file
+}
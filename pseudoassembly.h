@@ -1,9 +1,10 @@
 /**@<pseudoassembly.h>::**/
+#include <stdint.h>
 #include <mypas.h>
 
 /*unified label counter*/
 
-extern int labelcounter;
+extern _Thread_local int labelcounter;
 
 /*control pseudo instructions*/
 
@@ -15,12 +16,15 @@ int jge(int label);
 int jgt(int label);
 int jeq(int label);
 int jne(int label);
-int cmpl();
+int cmpint(char const *condition);
+int pushacc (void);
 int mklabel (int label);
 int lmovel (char const *variable);
 int lmoveq (char const *variable);
 int rmovel (char const *variable);
 int rmoveq (char const *variable);
+int rmovel_imm (int32_t constant);
+int rmoveq_imm (int64_t constant);
 
 /*ULA pseudo-instructions*/
 
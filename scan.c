@@ -0,0 +1,135 @@
+/**@<scan.c>::**/
+#include <stdint.h>
+#include <scan.h>
+#include <charclass.h>
+
+/* the scalar scanners: what other targets run, and the reference the
+vector ones have to agree with */
+static unsigned char const *scalar_scan_spaces(unsigned char const *p)
+{
+  while (charis(*p, CHAR_SPACE)) p++;
+  return p;
+}
+
+static unsigned char const *scalar_scan_alnum(unsigned char const *p)
+{
+  while (charis(*p, CHAR_ALNUM)) p++;
+  return p;
+}
+
+static unsigned char const *scalar_scan_to(unsigned char const *p, unsigned char c)
+{
+  while (*p && *p != c) p++;
+  return p;
+}
+
+static unsigned char const *(*run_spaces)(unsigned char const *) = scalar_scan_spaces;
+static unsigned char const *(*run_alnum)(unsigned char const *) = scalar_scan_alnum;
+static unsigned char const *(*run_to)(unsigned char const *, unsigned char) = scalar_scan_to;
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+
+#include <immintrin.h>
+
+/* bytes are compared as signed chars: everything above 0x7f is negative
+and therefore never inside the ASCII ranges below */
+#define vrange(v, low, high) vand(vgt(v, vset((low) - 1)), vgt(vset((high) + 1), v))
+
+// SSE2: 16 bytes a step, there on every x86-64
+#define VECTOR_SIZE 16
+#define VECTOR __m128i
+#define TARGET __attribute__((target("sse2")))
+#define VARIANT(name) sse2_##name
+#define vload(p)          _mm_load_si128((VECTOR const *) (p))
+#define vset(c)           _mm_set1_epi8(c)
+#define vor(a, b)         _mm_or_si128(a, b)
+#define vand(a, b)        _mm_and_si128(a, b)
+#define veq(a, b)         _mm_cmpeq_epi8(a, b)
+#define vgt(a, b)         _mm_cmpgt_epi8(a, b)
+#define vmask(a)          ((uint32_t) _mm_movemask_epi8(a))
+#define FULL_MASK         0xFFFFu
+#include <scanvec.h>
+#undef VECTOR_SIZE
+#undef VECTOR
+#undef TARGET
+#undef VARIANT
+#undef vload
+#undef vset
+#undef vor
+#undef vand
+#undef veq
+#undef vgt
+#undef vmask
+#undef FULL_MASK
+
+// AVX2: 32 bytes a step, compiled whatever the build flags and used where the cpu has it
+#define VECTOR_SIZE 32
+#define VECTOR __m256i
+#define TARGET __attribute__((target("avx2")))
+#define VARIANT(name) avx2_##name
+#define vload(p)          _mm256_load_si256((VECTOR const *) (p))
+#define vset(c)           _mm256_set1_epi8(c)
+#define vor(a, b)         _mm256_or_si256(a, b)
+#define vand(a, b)        _mm256_and_si256(a, b)
+#define veq(a, b)         _mm256_cmpeq_epi8(a, b)
+#define vgt(a, b)         _mm256_cmpgt_epi8(a, b)
+#define vmask(a)          ((uint32_t) _mm256_movemask_epi8(a))
+#define FULL_MASK         0xFFFFFFFFu
+#include <scanvec.h>
+
+int scan_select(int level)
+{
+  __builtin_cpu_init(); // may run before the constructors of libgcc
+  if (level >= SCAN_AVX2 && __builtin_cpu_supports("avx2")) {
+    run_spaces = avx2_scan_spaces;
+    run_alnum = avx2_scan_alnum;
+    run_to = avx2_scan_to;
+    return SCAN_AVX2;
+  }
+  if (level >= SCAN_SSE2 && __builtin_cpu_supports("sse2")) {
+    run_spaces = sse2_scan_spaces;
+    run_alnum = sse2_scan_alnum;
+    run_to = sse2_scan_to;
+    return SCAN_SSE2;
+  }
+  run_spaces = scalar_scan_spaces;
+  run_alnum = scalar_scan_alnum;
+  run_to = scalar_scan_to;
+  return SCAN_SCALAR;
+}
+
+#else
+
+int scan_select(int level)
+{
+  return SCAN_SCALAR;
+}
+
+#endif
+
+// the widest scanners the cpu runs, chosen once before main
+__attribute__((constructor)) static void scan_init(void)
+{
+  scan_select(SCAN_AVX2);
+}
+
+unsigned char const *scan_spaces(unsigned char const *p)
+{
+  if (!charis(*p, CHAR_SPACE)) // the common single-byte case never touches a vector
+    return p;
+  return run_spaces(p + 1);
+}
+
+unsigned char const *scan_alnum(unsigned char const *p)
+{
+  if (!charis(*p, CHAR_ALNUM))
+    return p;
+  return run_alnum(p + 1);
+}
+
+/* the search for a closing delimiter is a memchr that also stops at the
+sentinel, so it needs no length */
+unsigned char const *scan_to(unsigned char const *p, unsigned char c)
+{
+  return run_to(p, c);
+}
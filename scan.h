@@ -0,0 +1,21 @@
+/**@<scan.h>::**/
+
+/*
+ * run scanners: return the first byte at or after p that does not belong
+ * to the run. p must point into a tape buffer closed by its 0 sentinel,
+ * which ends every run. Blocks are read with aligned vector loads, which
+ * stay inside the tape: its buffers are 32-byte aligned and padded (see
+ * tape.c), and a mapped file is page aligned.
+ *
+ * On x86 the AVX2 (32 bytes) or SSE2 (16 bytes) scanners are picked at run
+ * time from what the cpu supports; other targets use a scalar loop.
+ */
+extern unsigned char const *scan_spaces(unsigned char const *p);   // [ \t\n\v\f\r]*
+extern unsigned char const *scan_alnum(unsigned char const *p);    // [A-Za-z0-9]*
+extern unsigned char const *scan_to(unsigned char const *p, unsigned char c); // [^c\0]*
+
+/* scan_select: the scanners to use from now on, at most the given level
+and no more than the cpu supports; returns the level selected. Not to be
+called while another thread is lexing */
+enum { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+extern int scan_select(int level);
@@ -0,0 +1,61 @@
+/**@<scanvec.h>::**/
+
+/*
+ * the vector scanners of scan.c, included once per vector width. The
+ * includer defines VECTOR, VECTOR_SIZE, FULL_MASK, the v* operations,
+ * TARGET (the instruction set the functions are compiled for) and
+ * VARIANT(name), which gives each width its own function names.
+ */
+
+static TARGET uint32_t VARIANT(spaces)(unsigned char const *block)
+{
+  VECTOR v = vload(block);
+  return vmask(vor(veq(v, vset(' ')), vrange(v, '\t', '\r')));
+}
+
+static TARGET uint32_t VARIANT(alnums)(unsigned char const *block)
+{
+  VECTOR v = vload(block);
+  VECTOR lower = vor(v, vset(0x20)); // folds A-Z onto a-z
+  return vmask(vor(vrange(lower, 'a', 'z'), vrange(v, '0', '9')));
+}
+
+/* first byte at or after p for which the class mask is not set */
+static TARGET unsigned char const *VARIANT(scan)(unsigned char const *p,
+                                                 uint32_t (*class)(unsigned char const *))
+{
+  uintptr_t misalign = (uintptr_t) p & (VECTOR_SIZE - 1);
+  unsigned char const *block = p - misalign;
+  uint32_t outside = ~class(block) & FULL_MASK & (FULL_MASK << misalign);
+
+  while (outside == 0) {
+    block += VECTOR_SIZE;
+    outside = ~class(block) & FULL_MASK;
+  }
+  return block + __builtin_ctz(outside);
+}
+
+static TARGET unsigned char const *VARIANT(scan_spaces)(unsigned char const *p)
+{
+  return VARIANT(scan)(p, VARIANT(spaces));
+}
+
+static TARGET unsigned char const *VARIANT(scan_alnum)(unsigned char const *p)
+{
+  return VARIANT(scan)(p, VARIANT(alnums));
+}
+
+static TARGET unsigned char const *VARIANT(scan_to)(unsigned char const *p, unsigned char c)
+{
+  uintptr_t misalign = (uintptr_t) p & (VECTOR_SIZE - 1);
+  unsigned char const *block = p - misalign;
+  VECTOR target = vset(c), zero = vset(0), v = vload(block);
+  uint32_t found = vmask(vor(veq(v, target), veq(v, zero))) & (FULL_MASK << misalign);
+
+  while (found == 0) {
+    block += VECTOR_SIZE;
+    v = vload(block);
+    found = vmask(vor(veq(v, target), veq(v, zero)));
+  }
+  return block + __builtin_ctz(found);
+}
@@ -0,0 +1,73 @@
+/**@<storage.c>::**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <tokens.h>
+#include <keywords.h>
+#include <intern.h>
+#include <symtab.h>
+#include <mypas.h>
+#include <storage.h>
+#include <alloc.h>
+
+// storage_size: bytes a variable of type takes; boolean is moved as 32 bits
+int storage_size(int type)
+{
+  switch(type) {
+    case DOUBLE:
+      return 8;
+    case INTEGER: case REAL: case BOOLEAN:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+// storage_align: natural alignment of type, the same as its size here
+int storage_align(int type)
+{
+  return storage_size(type);
+}
+
+// by decreasing alignment, in declaration order within the same alignment
+static int compare(void const *a, void const *b)
+{
+  int x = *(int const *) a, y = *(int const *) b;
+  int ax = storage_align(symtab_entry(x)->type), ay = storage_align(symtab_entry(y)->type);
+
+  return ax != ay ? ay - ax : x - y;
+}
+
+/* storage_layout: places every global in the symtab in .bss under its own
+label and emits their definitions to object. Returns the size of the area */
+long storage_layout(void)
+{
+  int *order, n = 0, i, entry, align;
+  long offset = 0;
+  SYMTAB_ENTRY *variable;
+
+  for(entry = 0; entry < symtab_nextentry; entry++)
+    n += symtab_entry(entry)->scope == 0;
+  if(n == 0)
+    return 0;
+  order = alloc_grow(NULL, n, sizeof *order, "storage");
+  for(entry = i = 0; entry < symtab_nextentry; entry++) {
+    if(symtab_entry(entry)->scope == 0)
+      order[i++] = entry;
+  }
+  qsort(order, n, sizeof *order, compare);
+
+  // the area starts at the strictest alignment of the variables in it
+  fprintf(object, "\t.bss\n\t.balign %d\n", storage_align(symtab_entry(order[0])->type));
+  for(i = 0; i < n; i++) {
+    variable = symtab_entry(order[i]);
+    align = storage_align(variable->type);
+    if(align && offset % align) { // only when a type is not a power of two
+      fprintf(object, "\t.zero %ld\n", align - offset % align);
+      offset += align - offset % align;
+    }
+    fprintf(object, "%s:\n\t.zero %d\n", intern_name(variable->name), storage_size(variable->type));
+    offset += storage_size(variable->type);
+  }
+  free(order);
+  return offset;
+}
@@ -0,0 +1,16 @@
+/**@<storage.h>::**/
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+/*
+ * storage allocation: every global variable of the symtab gets a size and
+ * an alignment from its type and a place in the .bss section. Variables are
+ * laid out by decreasing alignment, so that none needs padding and they
+ * take as few cache lines as their sizes allow. Code addresses them
+ * RIP-relative by name.
+ */
+extern int storage_size(int type);
+extern int storage_align(int type);
+extern long storage_layout(void);
+
+#endif
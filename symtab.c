@@ -1,65 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <parser.h>
 #include <lexer.h>
+#include <intern.h>
 #include <symtab.h>
+#include <alloc.h>
 
-// col 0 of symtab: location of the symbol name(symtab[i][1]) in the symtab_stream
-// col 1 of symtab: the type of the symbol
-int symtab[MAX_SYMTAB_ENTRIES][2];
-int symtab_nextentry = 0; // position of next entry in symtab
+#include <tokens.h>
 
-// symtab_stream: array with all the declared symbols
-// the right position of a symbol in the symtab_stream is stored in symtab
-char symtab_stream[MAX_SYMTAB_ENTRIES*(MAXID_SIZE+1)];
-// position of next item in the symtab_stream
-int symtab_stream_next_descriptor = 0;
+/* chunk c covers the entries from SYMTAB_CHUNK * (2^c - 1) on; 32 chunks
+are more than an int index can reach */
+static _Thread_local SYMTAB_ENTRY *chunks[32];
+_Thread_local int symtab_nextentry = 0; // position of next entry in symtab
 
-int symtab_lookup(char const *name)
+/* scopes are stacked on the entries: every open block remembers where its
+first entry goes, and closing it truncates the symtab back to that mark */
+static _Thread_local int *marks = NULL;
+static _Thread_local int nmarks = 0, marks_capacity = 0;
+
+// chunkof: the chunk of entry, and in *first the index its first entry has
+static int chunkof(int entry, int *first)
+{
+  int c = 31 - __builtin_clz((unsigned) entry / SYMTAB_CHUNK + 1);
+
+  *first = SYMTAB_CHUNK * ((1 << c) - 1);
+  return c;
+}
+
+SYMTAB_ENTRY *symtab_entry(int entry)
 {
+  int first, c = chunkof(entry, &first);
+
+  return &chunks[c][entry - first];
+}
+
+/* hash index over the symtab: open addressing with linear probing, keyed
+by the interned name. Every slot keeps the name's hash next to the entry it
+points at (entry + 1, 0 for an empty slot). The hash is a multiplication by
+an odd constant, which is one-to-one on 32 bits: equal hashes mean equal
+names, so a probe never has to look at the symtab itself.
+A slot points at the innermost declaration of its name; the ones it hides
+follow through the shadow links of the entries. A name whose every scope
+is closed keeps its slot as UNBOUND, so that no probe chain is broken. */
+typedef struct {
+  uint32_t hash;
+  int entry;
+} SLOT;
+
+static _Thread_local SLOT *slots = NULL;
+static _Thread_local uint32_t slots_mask = 0, slots_used = 0;
+
+#define UNBOUND -1
 
-  int i;
-  for(i = symtab_nextentry - 1; i > -1; i--){
-   if( strcmp(symtab_stream + symtab[i][0],name) == 0)
-    break;
+#define SYMTAB_HASH(name) ((uint32_t) (name) * 2654435761u)
+
+// probe: the slot that holds name, or the empty slot where it would go
+static SLOT *probe(uint32_t name)
+{
+  uint32_t h = SYMTAB_HASH(name), i;
+
+  for (i = h & slots_mask; slots[i].entry && slots[i].hash != h; i = (i + 1) & slots_mask);
+  return &slots[i];
+}
+
+// rehash: rebuilds the slot table at most a quarter full, leaving the unbound names out
+static void rehash(void)
+{
+  SLOT *old = slots;
+  uint32_t i, j, bound = 0, size = 0x40;
+
+  for (i = 0; old && i <= slots_mask; i++)
+    bound += old[i].entry > 0;
+  while (size < 4 * (bound + 1))
+    size *= 2;
+
+  slots = alloc_grow(NULL, size, sizeof *slots, "symtab");
+  memset(slots, 0, size * sizeof *slots);
+  for (i = 0; old && i <= slots_mask; i++) {
+    if (old[i].entry > 0) { // stored hashes: no entry is looked at again
+      for (j = old[i].hash & (size - 1); slots[j].entry; j = (j + 1) & (size - 1));
+      slots[j] = old[i];
+    }
   }
-  // at this point 'i' is either the value we want or -1, when didn't find
-  return i;
+  slots_mask = size - 1;
+  slots_used = bound;
+  free(old);
 }
 
-int symtab_append(char const *name, int type)
+int symtab_lookup(uint32_t name)
 {
-  int location = symtab_lookup(name);
+  int entry;
 
-  if(symtab_nextentry == MAX_SYMTAB_ENTRIES)
-    return -2; // no more space in symtab
-  if(location > -1 )
-    return -3; // 'name' does not exist in symtab
+  if (slots == NULL)
+    return -1;
+  // the innermost declaration of name, or -1 when it is not in scope
+  entry = probe(name)->entry;
+  return entry > 0 ? entry - 1 : -1;
+}
+
+int symtab_append(uint32_t name, int type)
+{
+  SLOT *slot;
+  SYMTAB_ENTRY *entry;
+  int first, c;
 
-  strcpy(symtab_stream + symtab_stream_next_descriptor, name);
+  if(slots == NULL || 2 * (slots_used + 1) > slots_mask)
+    rehash();
+  slot = probe(name);
+  // entries from the mark of the open scope on belong to it
+  if(slot->entry > 0 && slot->entry - 1 >= (nmarks ? marks[nmarks - 1] : 0))
+    return -3; // 'name' already exists in this scope
+  if(slot->entry == 0)
+    slots_used++;
 
-  // stroe the stream position in the symtab array
-  symtab[symtab_nextentry][0] = symtab_stream_next_descriptor;
-  // preview next stream entry position
-  symtab[symtab_nextentry][1] = type;
-  symtab_stream_next_descriptor += strlen(name) +1;
+  // the first entry of a chunk not yet there: the table doubles
+  c = chunkof(symtab_nextentry, &first);
+  if(chunks[c] == NULL)
+    chunks[c] = alloc_grow(NULL, (size_t) SYMTAB_CHUNK << c, sizeof(SYMTAB_ENTRY), "symtab");
+
+  // names are stored once, by the interner; the entry keeps only the id
+  entry = &chunks[c][symtab_nextentry - first];
+  entry->name = name;
+  entry->type = type;
+  entry->scope = nmarks;
+  entry->shadow = slot->entry > 0 ? slot->entry - 1 : -1;
+  slot->hash = SYMTAB_HASH(name);
+  slot->entry = symtab_nextentry + 1;
 
   return symtab_nextentry++;
 }
 
+// symtab_enter_scope: opens a block inside the current one, returns its depth
+int symtab_enter_scope(void)
+{
+  if(nmarks == marks_capacity) {
+    marks_capacity = marks_capacity ? 2 * marks_capacity : 0x10;
+    marks = alloc_grow(marks, marks_capacity, sizeof *marks, "symtab");
+  }
+  marks[nmarks++] = symtab_nextentry;
+  return nmarks;
+}
+
+/* symtab_exit_scope: closes the innermost block. Only its own entries are
+visited, each giving its slot back to the declaration it was hiding */
+void symtab_exit_scope(void)
+{
+  SYMTAB_ENTRY *entry;
+
+  if(nmarks == 0)
+    return;
+  while(symtab_nextentry > marks[nmarks - 1]) {
+    entry = symtab_entry(--symtab_nextentry);
+    probe(entry->name)->entry = entry->shadow >= 0 ? entry->shadow + 1 : UNBOUND;
+  }
+  nmarks--;
+}
+
+// symtab_reset: empties the symtab for the next compilation on this thread
+void symtab_reset(void)
+{
+  int c;
+
+  for(c = 0; c < 32 && chunks[c]; c++) {
+    free(chunks[c]);
+    chunks[c] = NULL;
+  }
+  symtab_nextentry = 0;
+  free(marks);
+  marks = NULL;
+  nmarks = marks_capacity = 0;
+  free(slots);
+  slots = NULL;
+  slots_mask = slots_used = 0;
+}
+
 //print_symtab_stream: a function to print the entire symtab, useful for debug purposes
 void print_symtab_stream(void)
 {
-  int a,b,fim,ini;
+  int a;
   for (a=0;a<symtab_nextentry;a++)
   {
-    //find where some variable starts in stream
-    b = symtab[a][0];
-    printf("\nsymtab entry #%d ",a);
-    //print until the end of such variable
-    while(symtab_stream[b]!='\0')
-    {
-    printf("%c",symtab_stream[b]);
-    b++;
-    }
+    printf("\nsymtab entry #%d %s",a,intern_name(symtab_entry(a)->name));
   }
 }
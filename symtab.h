@@ -1,8 +1,29 @@
-#define MAX_SYMTAB_ENTRIES  32
+#include <stdint.h>
 
-extern int symtab[MAX_SYMTAB_ENTRIES][2];
-extern int symtab_append(char const *name, int type);
+/*
+ * symtab entries live in chunks that are never moved: chunk c holds
+ * SYMTAB_CHUNK << c entries, so the table doubles as it fills and an index
+ * (or a pointer from symtab_entry) stays valid for the whole compilation.
+ *
+ * Blocks nest: symtab_enter_scope opens one inside the current block and
+ * symtab_exit_scope drops every entry declared since, uncovering the
+ * declarations they shadowed. symtab_lookup finds the innermost one.
+ */
+#define SYMTAB_CHUNK  64
+
+typedef struct {
+  uint32_t name; // the interned id of the symbol name (see intern.h)
+  int type;      // the type of the symbol
+  int scope;     // nesting depth of the declaring block, 0 for globals
+  int shadow;    // the entry of the same name this one hides, -1 if none
+} SYMTAB_ENTRY;
+
+extern _Thread_local int symtab_nextentry; // entries in use, the next one to append
+extern SYMTAB_ENTRY *symtab_entry(int entry);
+extern int symtab_append(uint32_t name, int type);
 void print_symtab_stream(void);
+void symtab_reset(void);
+extern int symtab_enter_scope(void);
+extern void symtab_exit_scope(void);
 
-extern int symtab_lookup(char const *name);
-extern char symtab_stream[];
+extern int symtab_lookup(uint32_t name);
@@ -0,0 +1,313 @@
+/**@<tape.c>::**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <tape.h>
+#include <scan.h>
+
+/* a source that is not mapped lives in a buffer aligned to the widest
+vector of scan.c and followed by zeroed slack of the same width, so that
+the aligned block holding any byte of it is inside the allocation */
+#define TAPE_ALIGN   32
+#define TAPE_PADDING 32
+
+static unsigned char *tape_alloc(size_t size)
+{
+  void *buffer;
+
+  return posix_memalign(&buffer, TAPE_ALIGN, size + TAPE_PADDING) ? NULL : buffer;
+}
+
+// tape_resize: a buffer of size with the first length bytes of buffer, which is freed
+static unsigned char *tape_resize(unsigned char *buffer, size_t length, size_t size)
+{
+  unsigned char *grown = tape_alloc(size);
+
+  if (grown == NULL)
+    return NULL;
+  memcpy(grown, buffer, length);
+  free(buffer);
+  return grown;
+}
+
+/*
+ * a regular file whose size is not a multiple of the page size is mapped
+ * straight from the page cache: the kernel fills the rest of the last page
+ * with zeros, which gives us the sentinel for free. Anything else (pipes,
+ * page-aligned sizes, empty files) is read into one malloc'ed buffer.
+ */
+static int tape_map(TAPE *tape, int fd)
+{
+  struct stat st;
+  long pagesize = sysconf(_SC_PAGESIZE);
+  void *area;
+
+  if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size == 0
+      || pagesize <= 0 || st.st_size % pagesize == 0)
+    return 0;
+
+  area = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (area == MAP_FAILED)
+    return 0;
+  madvise(area, st.st_size, MADV_SEQUENTIAL);
+
+  tape->head = area;
+  tape->tail = tape->head + st.st_size;
+  tape->mapped = st.st_size;
+  return 1;
+}
+
+static int tape_read(TAPE *tape, FILE *stream)
+{
+  size_t length = 0, capacity = 0x10000, n;
+  unsigned char *buffer = tape_alloc(capacity), *grown;
+
+  if (buffer == NULL)
+    return 0;
+  while ((n = fread(buffer + length, 1, capacity - length, stream)) > 0) {
+    length += n;
+    if (length == capacity) {
+      grown = tape_resize(buffer, length, 2 * capacity);
+      if (grown == NULL) {
+        free(buffer);
+        return 0;
+      }
+      buffer = grown;
+      capacity *= 2;
+    }
+  }
+  memset(buffer + length, 0, TAPE_PADDING); // sentinel
+
+  tape->head = buffer;
+  tape->tail = buffer + length;
+  tape->mapped = 0;
+  return 1;
+}
+
+TAPE *tape_open(FILE *stream)
+{
+  TAPE *tape;
+
+  if (stream == NULL || (tape = malloc(sizeof *tape)) == NULL)
+    return NULL;
+
+  if (!tape_map(tape, fileno(stream)) && !tape_read(tape, stream)) {
+    free(tape);
+    return NULL;
+  }
+  tape->cursor = tape->token = tape->head;
+  tape->lines = NULL;
+  tape->nlines = 0;
+  tape->stream = NULL;
+  tape->window = tape->base = tape->line = tape->linestart = 0;
+  return tape;
+}
+
+/* tape_stream: a tape that reads the source through a window of the given
+size, so that memory stays bounded however long the input is. A regular
+file is mapped whole instead, which costs nothing but page cache */
+TAPE *tape_stream(FILE *stream, size_t window)
+{
+  struct stat st;
+  TAPE *tape;
+  unsigned char *buffer;
+
+  if (stream == NULL)
+    return NULL;
+  if (fstat(fileno(stream), &st) == 0 && S_ISREG(st.st_mode))
+    return tape_open(stream);
+  if ((tape = calloc(1, sizeof *tape)) == NULL)
+    return NULL;
+  if ((buffer = tape_alloc(window)) == NULL) {
+    free(tape);
+    return NULL;
+  }
+  tape->head = tape->tail = tape->cursor = tape->token = buffer;
+  tape->stream = stream;
+  tape->window = window;
+  tape_refill(tape, tape->head);
+  return tape;
+}
+
+/* tape_refill: slides the window of a streamed tape so that it starts at
+keep, and reads as much more of the source as fits behind it. Everything
+before keep is gone afterwards; returns where keep now is */
+unsigned char const *tape_refill(TAPE *tape, unsigned char const *keep)
+{
+  unsigned char *buffer = (unsigned char *) tape->head;
+  unsigned char const *p;
+  size_t kept = tape->tail - keep, n;
+
+  if (tape->stream == NULL)
+    return keep;
+
+  // what is dropped still counts for the line numbers of what remains
+  for (p = tape->head; (p = scan_to(p, '\n')) < keep; p++) {
+    if (*p == '\n') {
+      tape->line++;
+      tape->linestart = tape->base + (p + 1 - tape->head);
+    }
+  }
+  tape->base += keep - tape->head;
+  tape->cursor = tape->cursor < keep ? buffer : buffer + (tape->cursor - keep);
+  tape->token = tape->token < keep ? buffer : buffer + (tape->token - keep);
+  memmove(buffer, keep, kept);
+
+  n = fread(buffer + kept, 1, tape->window - kept, tape->stream);
+  if (n < tape->window - kept) // end of the input, or an error reading it
+    tape->stream = NULL;
+  tape->tail = buffer + kept + n;
+  memset(buffer + kept + n, 0, TAPE_PADDING); // sentinel
+  return buffer;
+}
+
+/* tape_grow: doubles the window of a streamed tape and fills the new room,
+for a token that does not fit in what is left of it. Everything from the
+token on is kept; returns 0 when there is no more to read or no memory */
+int tape_grow(TAPE *tape)
+{
+  unsigned char *buffer;
+  size_t kept = tape->tail - tape->head;
+
+  if (tape->stream == NULL || (buffer = tape_alloc(2 * tape->window)) == NULL)
+    return 0;
+  memcpy(buffer, tape->head, kept);
+  tape->cursor = buffer + (tape->cursor - tape->head);
+  tape->token = buffer + (tape->token - tape->head);
+  tape->tail = buffer + kept;
+  free((void *) tape->head);
+  tape->head = buffer;
+  tape->window *= 2;
+  tape_refill(tape, tape->token);
+  return 1;
+}
+
+/* tape_edit: replaces removed bytes at offset by the inserted ones of text,
+keeping the sentinel; a mapped source is first copied, as the map is read-only */
+int tape_edit(TAPE *tape, size_t offset, size_t removed, char const *text, size_t inserted)
+{
+  size_t length = tape->tail - tape->head, size, rest;
+  unsigned char *buffer = (unsigned char *) tape->head;
+
+  if (tape->window || offset > length || removed > length - offset)
+    return 0;
+  size = length - removed + inserted;
+  rest = length - offset - removed;
+
+  if (tape->mapped) {
+    if ((buffer = tape_alloc(size)) == NULL)
+      return 0;
+    memcpy(buffer, tape->head, offset);
+    memcpy(buffer + offset + inserted, tape->head + offset + removed, rest);
+    munmap((void *)tape->head, tape->mapped);
+    tape->mapped = 0;
+  } else {
+    if (size > length && (buffer = tape_resize(buffer, length, size)) == NULL)
+      return 0;
+    memmove(buffer + offset + inserted, buffer + offset + removed, rest);
+  }
+  memcpy(buffer + offset, text, inserted);
+  memset(buffer + size, 0, TAPE_PADDING); // sentinel
+
+  tape->head = tape->cursor = tape->token = buffer;
+  tape->tail = buffer + size;
+  free(tape->lines); // rebuilt on the next lookup
+  tape->lines = NULL;
+  tape->nlines = 0;
+  return 1;
+}
+
+/*
+ * line index: tokens only carry byte offsets, so the lexer never counts
+ * newlines. The first diagnostic builds the table of line starts with the
+ * vector search of scan.c; every lookup is then a binary search in it.
+ */
+static int tape_index(TAPE *tape)
+{
+  size_t capacity = 0x400;
+  uint32_t *lines = malloc(capacity * sizeof *lines), *grown;
+  unsigned char const *p = tape->head;
+
+  if (lines == NULL)
+    return 0;
+  lines[tape->nlines++] = 0;
+  while ((p = scan_to(p, '\n')) < tape->tail) {
+    if (*p++ != '\n') // a 0 byte inside the source
+      continue;
+    if (tape->nlines == capacity) {
+      if ((grown = realloc(lines, 2 * capacity * sizeof *lines)) == NULL) {
+        free(lines);
+        tape->nlines = 0;
+        return 0;
+      }
+      lines = grown;
+      capacity *= 2;
+    }
+    lines[tape->nlines++] = p - tape->head;
+  }
+  tape->lines = lines;
+  return 1;
+}
+
+/* tape_count: like tape_position, but counts the lines from the head of
+what is in memory instead of building the index: the only way on a
+streamed tape, and for the lexer, which needs one position at most */
+void tape_count(TAPE const *tape, size_t offset, int *line, int *column)
+{
+  unsigned char const *p, *at;
+  size_t start = tape->linestart;
+
+  *line = *column = 0;
+  if (offset < tape->base || offset > tape->base + (tape->tail - tape->head))
+    return;
+  at = tape->head + (offset - tape->base);
+  *line = tape->line + 1;
+  for (p = tape->head; (p = scan_to(p, '\n')) < at; p++) {
+    if (*p == '\n') {
+      ++*line;
+      start = tape->base + (p + 1 - tape->head);
+    }
+  }
+  *column = offset - start + 1;
+}
+
+/* tape_position: 1-based line and column of the byte at offset; 0:0 when
+out of memory, or for a streamed tape when the byte is no longer (or not
+yet) in the window */
+void tape_position(TAPE *tape, size_t offset, int *line, int *column)
+{
+  size_t lo = 0, hi, mid;
+
+  if (tape->window) { // only the window is left: count from its start
+    tape_count(tape, offset, line, column);
+    return;
+  }
+  *line = *column = 0;
+  if (tape->lines == NULL && !tape_index(tape))
+    return;
+  // the last line starting at or before offset
+  for (hi = tape->nlines; hi - lo > 1; ) {
+    mid = lo + (hi - lo) / 2;
+    if (tape->lines[mid] <= offset)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  *line = lo + 1;
+  *column = offset - tape->lines[lo] + 1;
+}
+
+void tape_close(TAPE *tape)
+{
+  if (tape == NULL)
+    return;
+  if (tape->mapped)
+    munmap((void *)tape->head, tape->mapped);
+  else
+    free((void *)tape->head);
+  free(tape->lines);
+  free(tape);
+}
@@ -0,0 +1,47 @@
+/**@<tape.h>::**/
+#ifndef _TAPE_H_
+#define _TAPE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * the whole source file sits in one contiguous buffer, closed by a 0
+ * sentinel at *tail; recognizers advance the cursor over it and backtrack
+ * by resetting the cursor instead of pushing characters back with ungetc
+ *
+ * A streamed tape (tape_stream) holds only a window of the source: head is
+ * the start of the window, base its offset in the source, and tail the end
+ * of what has been read so far. The lexer calls tape_refill between tokens
+ * to slide the window along, so a token can backtrack anywhere within it,
+ * and tape_grow when a token runs into the end of the window.
+ */
+typedef struct {
+  unsigned char const *head;   // first byte of the source
+  unsigned char const *tail;   // one past the last byte of the source
+  unsigned char const *cursor; // next byte to be read
+  unsigned char const *token;  // first byte of the last token gettoken returned
+  size_t mapped;               // length of the mmap'ed area, 0 if malloc'ed
+  uint32_t *lines;             // offset of every line start, built by tape_position
+  size_t nlines;               // lines in the index, 0 until it is built
+  FILE *stream;                // where a streamed tape reads more from, NULL at its end
+  size_t window;               // capacity of a streamed tape, 0 for a whole source
+  size_t base;                 // source offset of head
+  size_t line;                 // newlines in the source before head
+  size_t linestart;            // source offset of the line head is in
+} TAPE;
+
+/* the first window of a streamed tape; a token that outgrows what is left
+of it doubles it (tape_grow) */
+#define TAPE_WINDOW 0x10000
+
+extern TAPE *tape_open(FILE *);
+extern TAPE *tape_stream(FILE *, size_t window);
+extern unsigned char const *tape_refill(TAPE *, unsigned char const *keep);
+extern int tape_grow(TAPE *);
+extern int tape_edit(TAPE *, size_t offset, size_t removed, char const *text, size_t inserted);
+extern void tape_position(TAPE *, size_t offset, int *line, int *column);
+extern void tape_count(TAPE const *, size_t offset, int *line, int *column);
+extern void tape_close(TAPE *);
+
+#endif
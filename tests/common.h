@@ -0,0 +1,57 @@
+/**@<common.h>::**/
+#ifndef _TESTS_COMMON_H_
+#define _TESTS_COMMON_H_
+
+/*
+ * helpers the test programs share: a fixed-seed random generator, so that a
+ * failure shows up again on the next run, and comparisons of tokens
+ */
+
+#include <stdint.h>
+#include <tokens.h>
+#include <tokbuf.h>
+
+static uint64_t state = 0x9E3779B97F4A7C15;
+
+// pick: a pseudo-random number below n (xorshift64)
+static inline unsigned pick(unsigned n)
+{
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state % n;
+}
+
+/* same_value: whether two values of a token are equal; an ID sets only
+the low half of lexval, so only the member that counts is compared */
+static inline int same_value(int token, LEXVAL const *a, LEXVAL const *b)
+{
+  switch (token) {
+  case ID:
+    return a->id == b->id;
+  case INTCONST: case OCTAL: case HEX:
+    return a->integer == b->integer;
+  case UNTERMINATED:
+    return a->opening.line == b->opening.line && a->opening.column == b->opening.column;
+  case FLTCONST: case DBLCONST:
+    return a->real == b->real;
+  }
+  return 1;
+}
+
+// same_tokens: whether two token buffers hold the same tokens, offsets, lengths and values
+static inline int same_tokens(TOKBUF const *a, TOKBUF const *b)
+{
+  size_t i;
+
+  if (a->count != b->count)
+    return 0;
+  for (i = 0; i < a->count; i++) {
+    if (a->kind[i] != b->kind[i] || tokbuf_offset(a, i) != tokbuf_offset(b, i)
+        || a->length[i] != b->length[i] || !same_value(a->kind[i], &a->value[i], &b->value[i]))
+      return 0;
+  }
+  return 1;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/**@<paralleltest.c>::**/
+
+/*
+ * paralleltest: tokbuf_lex_parallel against tokbuf_lex. Random programs of
+ * a few megabytes (a chunk takes at least a megabyte, so several threads
+ * get one) are lexed on 2 to 5 threads and have to give the same tokens,
+ * ids included. Comments of every length make the cuts between chunks fall
+ * inside them, and a comment left open somewhere before the last chunk has
+ * to come out as the one UNTERMINATED token the sequential lexer finds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tape.h>
+#include <tokbuf.h>
+#include <lexer.h>
+#include <intern.h>
+#include "common.h"
+
+#define SIZE 0x400000
+
+static char const *pieces[] = {
+  "var ", "begin\n", "end;\n", " := ", "<=", "..", ";", "(", ")", "x", "Count",
+  "0x1F ", "017 ", "3.25e-2 ", "1.5d0 ", "{ a comment }", "(* another *)", " ",
+  "\n", "alpha", "beta2 ", "{ (* } ", "(* { *) ",
+};
+#define NPIECES (sizeof pieces / sizeof *pieces)
+
+/* random_program: about size bytes of source; open, if not NULL, is put
+between 1/8 and 3/8 of it (before the last chunk) and nothing after it
+closes the comment */
+static size_t random_program(char *text, size_t size, char const *open)
+{
+  size_t length = 0, n, at = open ? size / 8 + pick(size / 4) : size;
+  char const *piece;
+
+  while (length < size - 64) {
+    if (length >= at) {
+      n = strlen(open);
+      memcpy(text + length, open, n);
+      for (length += n; length < size - 64; )
+        text[length++] = "ab1 \n;"[pick(6)];
+      break;
+    } else if (pick(50000) == 0) { // a comment long enough to hide a cut
+      text[length++] = '{';
+      for (n = pick(0x80000); n-- && length < size - 64; )
+        text[length++] = "ab {(*)\n"[pick(8)];
+      piece = "}";
+    } else {
+      piece = pieces[pick(NPIECES)];
+    }
+    n = strlen(piece);
+    memcpy(text + length, piece, n);
+    length += n;
+  }
+  return length;
+}
+
+static int check(char const *text, size_t length, int nthreads, char const *what)
+{
+  FILE *input = fmemopen((void *) text, length, "r");
+  TAPE *tape;
+  TOKBUF *sequential, *parallel;
+  size_t i, unterminated = 0;
+  int same;
+
+  if (input == NULL || (tape = tape_open(input)) == NULL)
+    return 1;
+  fclose(input);
+  sequential = tokbuf_lex(tape);
+  intern_reset();
+  tape->cursor = tape->token = tape->head;
+  parallel = tokbuf_lex_parallel(tape, nthreads);
+  intern_reset();
+
+  same = sequential != NULL && parallel != NULL && same_tokens(sequential, parallel);
+  for (i = 0; same && i < sequential->count; i++)
+    unterminated += sequential->kind[i] == UNTERMINATED;
+  if (!same || unterminated != (what != NULL)) {
+    fprintf(stderr, "paralleltest: %d threads%s%s: %zu tokens, %zu lexed sequentially\n", nthreads,
+      what ? ", comment left open with " : "", what ? what : "",
+      parallel ? parallel->count : 0, sequential ? sequential->count : 0);
+    same = 0;
+  }
+  tokbuf_free(sequential);
+  tokbuf_free(parallel);
+  tape_close(tape);
+  return !same;
+}
+
+int main(void)
+{
+  static char text[SIZE];
+  static char const *open[] = { NULL, "{ never closed ", "(* never closed " };
+  size_t length;
+  int nthreads, k, failed = 0;
+
+  for (nthreads = 2; nthreads <= 5 && !failed; nthreads++) {
+    for (k = 0; k < 3 && !failed; k++) {
+      lexer_mode = nthreads & 1 ? DFA_LEXER : HAND_LEXER;
+      length = random_program(text, SIZE, open[k]);
+      failed = check(text, length, nthreads, open[k]);
+    }
+  }
+  printf("paralleltest: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
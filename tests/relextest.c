@@ -0,0 +1,99 @@
+/**@<relextest.c>::**/
+
+/*
+ * relextest: tokbuf_relex against lexing from scratch. A random program
+ * gets a long series of small edits, mostly near the previous one as
+ * typing would make them; after every edit the patched token buffer has to
+ * equal a fresh tokbuf_lex of the edited tape, offsets, lengths and values
+ * included, with either lexer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tape.h>
+#include <tokbuf.h>
+#include <lexer.h>
+#include "common.h"
+
+// fragments that make tokens merge, split or turn into others when spliced
+static char const *pieces[] = {
+  "a", "1", ".", "..", "e", "+", "x", "0x1F", " ", "\n", ":=", "1.5e", "d3",
+  "beta", "017", ":", "=", "<", ">", "(", ")", "9", "E-", "_", "{", "}",
+  "(*", "*)", "begin", "end", ";",
+};
+#define NPIECES (sizeof pieces / sizeof *pieces)
+
+static void random_text(char *text, size_t size)
+{
+  size_t length = 0, n;
+  char const *piece;
+
+  text[0] = 0;
+  while ((n = strlen(piece = pieces[pick(NPIECES)])) < size - length) {
+    memcpy(text + length, piece, n + 1);
+    length += n;
+    if (size - length < 8)
+      break;
+  }
+}
+
+static int run(int mode, int edits)
+{
+  static char program[0x2000];
+  char text[24];
+  FILE *input;
+  TAPE *tape, scratch;
+  TOKBUF *tokens, *fresh;
+  size_t length, offset = 0, removed;
+  int i;
+
+  lexer_mode = mode;
+  random_text(program, sizeof program);
+  if ((input = fmemopen(program, strlen(program), "r")) == NULL || (tape = tape_open(input)) == NULL)
+    return 1;
+  fclose(input);
+  tokens = tokbuf_lex(tape);
+
+  for (i = 0; i < edits; i++) {
+    length = tape->tail - tape->head;
+    // mostly around the last edit, now and then anywhere
+    if (pick(8) == 0 || length == 0)
+      offset = pick(length + 1);
+    else
+      offset = offset + pick(9) < 4 ? 0 : offset + pick(9) - 4;
+    if (offset > length)
+      offset = length;
+    removed = pick(4);
+    if (removed > length - offset)
+      removed = length - offset;
+    random_text(text, 1 + pick(sizeof text - 1));
+    if (pick(3) == 0)
+      text[0] = 0;
+
+    if (tokbuf_relex(tokens, tape, offset, removed, text, strlen(text)) < 0) {
+      fprintf(stderr, "relextest: out of memory\n");
+      return 1;
+    }
+    scratch = *tape;
+    scratch.cursor = scratch.head;
+    fresh = tokbuf_lex(&scratch);
+    if (fresh == NULL || !same_tokens(tokens, fresh)) {
+      fprintf(stderr, "relextest: %s lexer, edit %d at %zu (-%zu +\"%s\"): tokens differ\n",
+        mode == DFA_LEXER ? "dfa" : "hand", i, offset, removed, text);
+      return 1;
+    }
+    tokbuf_free(fresh);
+  }
+  tokbuf_free(tokens);
+  tape_close(tape);
+  return 0;
+}
+
+int main(void)
+{
+  int failed = run(HAND_LEXER, 3000) || run(DFA_LEXER, 3000);
+
+  printf("relextest: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
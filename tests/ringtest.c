@@ -0,0 +1,107 @@
+/**@<ringtest.c>::**/
+
+/*
+ * ringtest: the lookahead ring against the token buffer. A random program
+ * is lexed whole into a TOKBUF, and on demand through a small streamed
+ * window into a TOKRING, each into a fresh name pool. Advancing both, with
+ * peeks of random depth in between, has to give the same tokens, offsets
+ * and values (of the tokens that carry one), ids included, and a peek must
+ * leave lexval and lexeme as they were. Names and numbers longer than half
+ * the window make the stream grow it in the middle of a token, and the
+ * program ends in a comment left open, longer than the windows, which has
+ * to be placed at the same line and column either way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tape.h>
+#include <tokbuf.h>
+#include <lexer.h>
+#include <intern.h>
+#include "common.h"
+
+static char const *pieces[] = {
+  "var ", "begin\n", "end;\n", " := ", "<=", "..", ";", "(", ")", "x", "Count",
+  "0x1F", "017", "3.25e-2", "1.5d0", "{ a comment }", "(* another *)", " ", "\n",
+  "longidentifierthatgoesonandonalongidentifierthatgoesonandon", "31415926535897932384626",
+};
+#define NPIECES (sizeof pieces / sizeof *pieces)
+
+static int run(size_t window)
+{
+  static char program[0x8000];
+  size_t length = 0, n, i;
+  char const *piece;
+  FILE *whole, *streamed;
+  TAPE *tape, *stream;
+  TOKBUF *tokens;
+  TOKRING ring;
+  LEXVAL value;
+  char text[LEXEME_SIZE + 1];
+  int token, expected, peeked;
+  unsigned k;
+  uint32_t names;
+
+  while ((n = strlen(piece = pieces[pick(NPIECES)])) < sizeof program - 0x800 - length) {
+    memcpy(program + length, piece, n);
+    length += n;
+  }
+  length += sprintf(program + length, "\n  (* left open");
+  while (length < sizeof program - 1)
+    program[length++] = "ab \n"[pick(4)];
+  whole = fmemopen(program, length, "r");
+  streamed = fmemopen(program, length, "r");
+  if (whole == NULL || streamed == NULL || (tape = tape_open(whole)) == NULL
+      || (stream = tape_stream(streamed, window)) == NULL || (tokens = tokbuf_lex(tape)) == NULL)
+    return 1;
+  names = intern_count();
+  intern_reset(); // the ring has to hand out the same ids from scratch
+  tokring_init(&ring, stream);
+
+  for (i = 0; ; i++) {
+    token = tokring_advance(&ring);
+    value = lexval;
+    expected = tokbuf_advance(tokens);
+    if (token != expected || ring.offset != tokbuf_offset(tokens, i)
+        || !same_value(token, &value, &lexval)) {
+      fprintf(stderr, "ringtest: window %zu, token %zu: %d, expected %d\n", window, i, token, expected);
+      return 1;
+    }
+    if (pick(3) == 0) {
+      k = pick(TOKRING_SIZE);
+      value = lexval;
+      strcpy(text, lexeme);
+      peeked = tokring_peek(&ring, k);
+      if (peeked != tokbuf_peek(tokens, k) || !same_value(token, &value, &lexval) || strcmp(text, lexeme)) {
+        fprintf(stderr, "ringtest: window %zu, token %zu: peek %u went wrong\n", window, i, k);
+        return 1;
+      }
+      if (tokring_peek(&ring, TOKRING_SIZE + k) != 0) { // out of reach: no token at all
+        fprintf(stderr, "ringtest: window %zu, token %zu: peek %u past the ring\n", window, i, TOKRING_SIZE + k);
+        return 1;
+      }
+    }
+    if (token == EOF)
+      break;
+  }
+  if (intern_count() != names) {
+    fprintf(stderr, "ringtest: window %zu: %u names interned, expected %u\n", window, intern_count(), names);
+    return 1;
+  }
+  intern_reset();
+  tokbuf_free(tokens);
+  tape_close(tape);
+  tape_close(stream);
+  fclose(whole);
+  fclose(streamed);
+  return 0;
+}
+
+int main(void)
+{
+  int failed = run(64) || run(1024) || run(TAPE_WINDOW);
+
+  printf("ringtest: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
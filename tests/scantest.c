@@ -0,0 +1,121 @@
+/**@<scantest.c>::**/
+
+/*
+ * scantest: the vector scanners of scan.c against the scalar ones. Random
+ * Pascal-like sources are scanned from every offset by each level the cpu
+ * supports, and lexed into token buffers that have to match the scalar
+ * lexer token for token. Sources are read both mapped and malloc'ed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <scan.h>
+#include <tape.h>
+#include <tokbuf.h>
+#include <intern.h>
+#include "common.h"
+
+static char const *pieces[] = {
+  "var", "begin", "end", ":=", "<=", "..", ";", "(", ")", "x", "Count",
+  "0x1F", "017", "3.25e-2", "1.5d0", "{ a comment }", "(* another *)",
+  " ", "  ", "\t", "\n", "\r\n", "\f", "\xC3\xA9", "@", "'",
+};
+#define NPIECES (sizeof pieces / sizeof *pieces)
+
+// source: a random program of about size bytes
+static size_t source(char *text, size_t size)
+{
+  size_t length = 0, n;
+  char const *piece;
+
+  while (length < size) {
+    switch (pick(8)) {
+    case 0: // a long run of one class, across several vectors
+      for (n = pick(100); n-- && length < size; )
+        text[length++] = pick(2) ? "aZ9_"[pick(4)] : " \t\n"[pick(3)];
+      break;
+    default:
+      piece = pieces[pick(NPIECES)];
+      if (length + (n = strlen(piece)) > size)
+        return length;
+      memcpy(text + length, piece, n);
+      length += n;
+      break;
+    }
+  }
+  return length;
+}
+
+static TAPE *open(char const *text, size_t length, int mapped)
+{
+  FILE *input = mapped ? tmpfile() : fmemopen((void *) text, length, "r");
+  TAPE *tape;
+
+  if (input == NULL)
+    return NULL;
+  if (mapped) {
+    fwrite(text, 1, length, input);
+    rewind(input);
+  }
+  tape = tape_open(input);
+  fclose(input);
+  return tape;
+}
+
+static int check(char const *text, size_t length, int mapped, int top)
+{
+  TAPE *tape = open(text, length, mapped);
+  TOKBUF *reference, *tokens;
+  unsigned char const *p;
+  int level, failures = 0;
+
+  if (tape == NULL) {
+    fprintf(stderr, "scantest: cannot open a source\n");
+    return 1;
+  }
+  scan_select(SCAN_SCALAR);
+  reference = tokbuf_lex(tape);
+  intern_reset();
+
+  for (level = SCAN_SSE2; level <= top; level++) {
+    scan_select(level);
+    for (p = tape->head; p <= tape->tail; p++) {
+      unsigned char const *spaces = scan_spaces(p), *alnum = scan_alnum(p), *to = scan_to(p, '}');
+
+      scan_select(SCAN_SCALAR);
+      if (spaces != scan_spaces(p) || alnum != scan_alnum(p) || to != scan_to(p, '}')) {
+        fprintf(stderr, "scantest: level %d disagrees at offset %zu\n", level, (size_t) (p - tape->head));
+        failures++;
+        break;
+      }
+      scan_select(level);
+    }
+    tape->cursor = tape->token = tape->head;
+    tokens = tokbuf_lex(tape);
+    intern_reset();
+    if (reference == NULL || tokens == NULL || !same_tokens(reference, tokens)) {
+      fprintf(stderr, "scantest: level %d lexes other tokens\n", level);
+      failures++;
+    }
+    tokbuf_free(tokens);
+  }
+  tokbuf_free(reference);
+  tape_close(tape);
+  return failures;
+}
+
+int main(void)
+{
+  static char text[0x4000];
+  int top = scan_select(SCAN_AVX2), failures = 0, i;
+  size_t length;
+
+  for (i = 0; i < 200 && failures == 0; i++) {
+    length = source(text, 1 + pick(sizeof text - 1));
+    failures += check(text, length, i & 1, top);
+  }
+  printf("scantest: %s up to %s\n", failures ? "FAILED" : "passed",
+    top == SCAN_AVX2 ? "avx2" : top == SCAN_SSE2 ? "sse2" : "scalar");
+  return failures != 0;
+}
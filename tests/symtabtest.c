@@ -0,0 +1,133 @@
+/**@<symtabtest.c>::**/
+
+/*
+ * symtabtest: block scopes of the symtab. A fixed script checks that an
+ * inner declaration shadows an outer one, that the outer one is found again
+ * when the block closes, and that a name may be declared once per block.
+ * Then a long random series of declarations, lookups and block entries and
+ * exits is run against a plain stack of declarations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <intern.h>
+#include <symtab.h>
+#include "common.h"
+
+#define EXPECT(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "symtabtest: line %d: %s\n", __LINE__, #condition); \
+      return 1; \
+    } \
+  } while (0)
+
+static uint32_t name(char const *text)
+{
+  return intern(text, strlen(text));
+}
+
+// type: the type of the innermost declaration of text, -1 when there is none
+static int type(char const *text)
+{
+  int entry = symtab_lookup(name(text));
+
+  return entry < 0 ? -1 : symtab_entry(entry)->type;
+}
+
+static int scripted(void)
+{
+  int x, y;
+
+  EXPECT((x = symtab_append(name("x"), 1)) == 0);
+  EXPECT((y = symtab_append(name("y"), 2)) == 1);
+  EXPECT(symtab_append(name("X"), 3) == -3); // Pascal names ignore case
+  EXPECT(symtab_entry(x)->scope == 0 && symtab_entry(x)->shadow == -1);
+
+  EXPECT(symtab_enter_scope() == 1);
+  EXPECT(type("x") == 1); // not shadowed yet
+  EXPECT(symtab_append(name("x"), 10) == 2);
+  EXPECT(symtab_entry(2)->scope == 1 && symtab_entry(2)->shadow == x);
+  EXPECT(type("x") == 10 && type("y") == 2);
+  EXPECT(symtab_append(name("x"), 11) == -3);
+  EXPECT(symtab_append(name("z"), 12) == 3);
+
+  EXPECT(symtab_enter_scope() == 2);
+  EXPECT(symtab_append(name("x"), 20) == 4 && symtab_entry(4)->shadow == 2);
+  EXPECT(symtab_append(name("y"), 21) == 5);
+  EXPECT(type("x") == 20 && type("y") == 21 && type("z") == 12);
+  symtab_exit_scope();
+
+  EXPECT(symtab_nextentry == 4);
+  EXPECT(type("x") == 10 && type("y") == 2 && type("z") == 12);
+  symtab_exit_scope();
+
+  EXPECT(symtab_nextentry == 2);
+  EXPECT(type("x") == 1 && type("y") == 2 && type("z") == -1);
+  EXPECT(symtab_append(name("z"), 4) == 2); // z is free again at the top
+  symtab_exit_scope(); // nothing to close: the globals stay
+  EXPECT(type("x") == 1 && type("z") == 4);
+
+  symtab_reset();
+  EXPECT(symtab_nextentry == 0 && type("x") == -1);
+  return 0;
+}
+
+#define NAMES 300
+#define STEPS 400000
+#define DEPTH 900
+
+// the model: every declaration in scope, innermost last
+static struct { uint32_t name; int type, scope; } model[STEPS];
+
+static int random_blocks(void)
+{
+  static int marks[DEPTH];
+  int n = 0, depth = 0, step, i, entry, duplicate;
+  uint32_t id;
+
+  for (step = 0; step < STEPS; step++) {
+    switch (pick(10)) {
+    case 0:
+      if (depth < DEPTH) {
+        marks[depth++] = n;
+        EXPECT(symtab_enter_scope() == depth);
+      }
+      break;
+    case 1:
+      if (depth) {
+        n = marks[--depth];
+        symtab_exit_scope();
+      }
+      break;
+    case 2: case 3: case 4: case 5:
+      id = 1 + pick(NAMES);
+      for (i = n - 1; i >= (depth ? marks[depth - 1] : 0) && model[i].name != id; i--);
+      duplicate = i >= (depth ? marks[depth - 1] : 0);
+      entry = symtab_append(id, step);
+      EXPECT(duplicate ? entry == -3 : entry == n);
+      if (!duplicate) {
+        model[n].name = id;
+        model[n].type = step;
+        model[n++].scope = depth;
+      }
+      break;
+    default:
+      id = 1 + pick(NAMES);
+      for (i = n - 1; i >= 0 && model[i].name != id; i--);
+      EXPECT(symtab_lookup(id) == i);
+      EXPECT(i < 0 || (symtab_entry(i)->type == model[i].type && symtab_entry(i)->scope == model[i].scope));
+    }
+  }
+  symtab_reset();
+  return 0;
+}
+
+int main(void)
+{
+  int failed = scripted() || random_blocks() || random_blocks();
+
+  printf("symtabtest: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
@@ -0,0 +1,508 @@
+/**@<tokbuf.c>::**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <tokens.h>
+#include <tokbuf.h>
+#include <lexer.h>
+#include <intern.h>
+#include <keywords.h>
+#include <charclass.h>
+
+static int tokbuf_grow(TOKBUF *tokens, size_t capacity)
+{
+  uint16_t *kind = realloc(tokens->kind, capacity * sizeof *kind);
+  uint32_t *offset, *length;
+  LEXVAL *value;
+
+  if (kind == NULL)
+    return 0;
+  tokens->kind = kind;
+  if ((offset = realloc(tokens->offset, capacity * sizeof *offset)) == NULL)
+    return 0;
+  tokens->offset = offset;
+  if ((length = realloc(tokens->length, capacity * sizeof *length)) == NULL)
+    return 0;
+  tokens->length = length;
+  if ((value = realloc(tokens->value, capacity * sizeof *value)) == NULL)
+    return 0;
+  tokens->value = value;
+  tokens->capacity = capacity;
+  return 1;
+}
+
+static int lex_next(TAPE *tape)
+{
+  // tokens without a value keep a zero one, not whatever the last had
+  lexval = (LEXVAL) {0};
+  return gettoken(tape);
+}
+
+// tokbuf_push: appends the token gettoken just returned from tape
+static int tokbuf_push(TOKBUF *tokens, TAPE const *tape, int token)
+{
+  size_t i = tokens->count;
+
+  if (i == tokens->capacity && !tokbuf_grow(tokens, 2 * tokens->capacity + 16))
+    return 0;
+  tokens->kind[i] = token == EOF ? 0 : token;
+  tokens->offset[i] = tape->token - tape->head;
+  tokens->length[i] = tape->cursor - tape->token;
+  tokens->value[i] = lexval;
+  tokens->count++;
+  return 1;
+}
+
+/* lex_until: runs gettoken from the tape cursor and keeps every token that
+starts before end; EOF, which starts at the tail, is kept only when end is
+the tail of the tape. A comment left open runs to the tail: its UNTERMINATED
+token and the EOF after it are kept whatever end is */
+static TOKBUF *lex_until(TAPE *tape, unsigned char const *end)
+{
+  TOKBUF *tokens = calloc(1, sizeof *tokens);
+  int token;
+
+  if (tokens == NULL)
+    return NULL;
+  tokens->source = tape->head;
+  /* about one token every four bytes of source is a generous first guess */
+  if (!tokbuf_grow(tokens, (end - tape->cursor) / 4 + 16)) {
+    tokbuf_free(tokens);
+    return NULL;
+  }
+
+  for (;;) {
+    token = lex_next(tape);
+    if (token == UNTERMINATED)
+      end = tape->tail;
+    if (tape->token >= end && end != tape->tail)
+      break;
+    if (!tokbuf_push(tokens, tape, token)) {
+      tokbuf_free(tokens);
+      return NULL;
+    }
+    if (token == EOF)
+      break;
+  }
+
+  return tokens;
+}
+
+// tokbuf_lex: runs gettoken over the whole tape, EOF included
+TOKBUF *tokbuf_lex(TAPE *tape)
+{
+  return lex_until(tape, tape->tail);
+}
+
+// tokbuf_offset: first byte of token i in the tape
+size_t tokbuf_offset(TOKBUF const *tokens, size_t i)
+{
+  return i >= tokens->shifted ? (uint32_t) (tokens->offset[i] + tokens->shift) : tokens->offset[i];
+}
+
+/* old_token: index of the token starting at offset, or tokens->count if none
+does. An UNTERMINATED comment never matches, on either side: whether one is
+left open depends on everything before it */
+static size_t old_token(TOKBUF const *tokens, size_t from, size_t offset)
+{
+  size_t lo = from, hi = tokens->count, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (tokbuf_offset(tokens, mid) < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < tokens->count && tokbuf_offset(tokens, lo) == offset && tokens->kind[lo] != UNTERMINATED)
+    return lo;
+  return tokens->count;
+}
+
+/*
+ * parallel lexing: the tape is cut into one chunk per thread at whitespace
+ * and every chunk is lexed on its own thread with a private cursor. A cut
+ * may still fall inside a comment, so stitching checks that each chunk
+ * begins where the sequential lexer would start a token; when it does not,
+ * the start of the chunk is lexed again from the right place until it
+ * meets a token the thread found too, as tokbuf_relex does after an edit.
+ * Each thread interns into its own (thread-local) pool; stitching interns
+ * every name again in token order, which hands out exactly the ids the
+ * sequential lexer would, and relabels the chunk's ID tokens.
+ * A comment left open swallows the rest of the source, later chunks too:
+ * stitching stops at the first chunk that ends in EOF.
+ */
+
+#define MIN_CHUNK_SIZE 0x100000 // not worth a thread below this
+
+typedef struct {
+  TAPE tape;                 // private cursor over the shared source
+  unsigned char const *end;  // tokens starting here belong to the next chunk
+  unsigned char const *next; // where the first token past end starts
+  TOKBUF *tokens;
+  uint32_t nnames;
+  LEXSTATS *stats;           // the thread's --lex-stats counters, for the job's
+} CHUNK;
+
+static void *lex_chunk(void *arg)
+{
+  CHUNK *chunk = arg;
+
+  chunk->tokens = lex_until(&chunk->tape, chunk->end);
+  chunk->next = chunk->tape.token;
+  chunk->nnames = intern_count();
+  intern_reset();
+  if (lex_stats)
+    chunk->stats = lexstats_save();
+  return NULL;
+}
+
+static void chunk_free(CHUNK *chunks, int nchunks)
+{
+  int k;
+
+  for (k = 0; k < nchunks; k++)
+    tokbuf_free(chunks[k].tokens);
+  free(chunks);
+}
+
+/* resync: lexes sequentially from start, where chunk really begins, into
+tokens until a token chunk has too; returns the index of that token in the
+chunk, or its count when none is left to keep. Like lex_until, it goes on to
+EOF once it finds a comment left open */
+static size_t resync(TOKBUF *tokens, CHUNK *chunk, TAPE const *tape, unsigned char const *start)
+{
+  TAPE scan = *tape;
+  TOKBUF *part = chunk->tokens;
+  unsigned char const *end = chunk->end;
+  size_t i;
+  int token;
+
+  scan.cursor = start;
+  for (;;) {
+    token = lex_next(&scan);
+    if (token == UNTERMINATED)
+      end = tape->tail;
+    if (scan.token >= end && end != tape->tail) {
+      chunk->next = scan.token; // the chunk was all inside a comment
+      return part->count;
+    }
+    if (token != UNTERMINATED && (i = old_token(part, 0, scan.token - scan.head)) < part->count)
+      return i;
+    if (!tokbuf_push(tokens, &scan, token))
+      return SIZE_MAX;
+    if (token == EOF)
+      return part->count;
+  }
+}
+
+// tokbuf_lex_parallel: same tokens and ids as tokbuf_lex, lexed on nthreads threads
+TOKBUF *tokbuf_lex_parallel(TAPE *tape, int nthreads)
+{
+  size_t size = tape->tail - tape->cursor, count = 0, n, i, kept;
+  unsigned char const *cut = tape->cursor;
+  pthread_t *threads;
+  CHUNK *chunks;
+  TOKBUF *tokens, *part;
+  uint32_t *map, id;
+  int k, started;
+
+  if (nthreads > 0 && (size_t) nthreads > size / MIN_CHUNK_SIZE)
+    nthreads = size / MIN_CHUNK_SIZE;
+  if (nthreads <= 1)
+    return tokbuf_lex(tape);
+
+  chunks = calloc(nthreads, sizeof *chunks);
+  threads = calloc(nthreads, sizeof *threads);
+  if (chunks == NULL || threads == NULL) {
+    free(chunks);
+    free(threads);
+    return tokbuf_lex(tape);
+  }
+
+  for (k = 0; k < nthreads; k++) {
+    chunks[k].tape = *tape;
+    chunks[k].tape.cursor = cut;
+    if (k == nthreads - 1) {
+      cut = tape->tail;
+    } else {
+      cut = tape->cursor + size / nthreads * (k + 1);
+      if (cut < chunks[k].tape.cursor)
+        cut = chunks[k].tape.cursor;
+      while (cut < tape->tail && !charis(*cut, CHAR_SPACE))
+        cut++;
+    }
+    chunks[k].end = cut;
+  }
+
+  for (started = 0; started < nthreads; started++) {
+    if (pthread_create(&threads[started], NULL, lex_chunk, &chunks[started]))
+      break;
+  }
+  for (k = 0; k < started; k++) {
+    pthread_join(threads[k], NULL);
+    lexstats_add(chunks[k].stats);
+  }
+  free(threads);
+  if (started < nthreads) { // out of threads: lex it all here instead
+    chunk_free(chunks, nthreads);
+    return tokbuf_lex(tape);
+  }
+
+  for (k = 0; k < nthreads; k++) {
+    if (chunks[k].tokens == NULL) {
+      chunk_free(chunks, nthreads);
+      return NULL;
+    }
+    count += chunks[k].tokens->count;
+  }
+
+  if ((tokens = calloc(1, sizeof *tokens)) == NULL || !tokbuf_grow(tokens, count)) {
+    tokbuf_free(tokens);
+    chunk_free(chunks, nthreads);
+    return NULL;
+  }
+  tokens->source = tape->head;
+
+  for (k = 0; k < nthreads; k++) {
+    part = chunks[k].tokens;
+    kept = 0;
+    // the first chunk starts where the sequential lexer does; the others must check
+    if (k > 0 && (part->count == 0
+                  || tape->head + part->offset[0] != chunks[k - 1].next)) {
+      kept = resync(tokens, &chunks[k], tape, chunks[k - 1].next);
+      if (kept == SIZE_MAX)
+        goto fail;
+    }
+    n = part->count - kept;
+    if (tokens->count + n > tokens->capacity && !tokbuf_grow(tokens, tokens->count + n))
+      goto fail;
+    if ((map = calloc(chunks[k].nnames + 1, sizeof *map)) == NULL)
+      goto fail;
+
+    memcpy(tokens->kind + tokens->count, part->kind + kept, n * sizeof *part->kind);
+    memcpy(tokens->offset + tokens->count, part->offset + kept, n * sizeof *part->offset);
+    memcpy(tokens->length + tokens->count, part->length + kept, n * sizeof *part->length);
+    memcpy(tokens->value + tokens->count, part->value + kept, n * sizeof *part->value);
+    for (i = 0; i < n; i++) {
+      if (part->kind[kept + i] != ID)
+        continue;
+      id = part->value[kept + i].id; // chunk-local id -> global id
+      if (map[id] == 0)
+        map[id] = intern((char const *) part->source + part->offset[kept + i],
+                         part->length[kept + i]);
+      tokens->value[tokens->count + i].id = map[id];
+    }
+    free(map);
+    tokens->count += n;
+    if (tokens->count && tokens->kind[tokens->count - 1] == 0) // EOF: the rest was in a comment
+      break;
+  }
+
+  chunk_free(chunks, nthreads);
+  tape->cursor = tape->token = tape->tail;
+  return tokens;
+
+fail:
+  tokbuf_free(tokens);
+  chunk_free(chunks, nthreads);
+  return NULL;
+}
+
+/*
+ * incremental re-lexing: after an edit only the tokens around it are lexed
+ * again. gettoken keeps no state but the cursor, so lexing restarts at the
+ * end of the last token the edit cannot have changed, and stops as soon as
+ * a token starts past the edit exactly where an old token started (shifted
+ * by the change in length): from there on the old tokens are still right.
+ * They are moved down the columns, and their offsets are shifted lazily:
+ * only the tokens between this edit and the previous one are rewritten.
+ */
+
+#define MOVE(column, to, from, n) \
+  memmove(tokens->column + (to), tokens->column + (from), (n) * sizeof *tokens->column)
+#define COPY(column, to, fresh, n) \
+  memcpy(tokens->column + (to), (fresh)->column, (n) * sizeof *tokens->column)
+
+/* tokbuf_relex: replaces removed bytes at offset of the tape by the inserted
+ones of text and brings tokens, which must hold the whole tape, up to date.
+Returns how many tokens were lexed again, or -1 when out of memory, after
+which tokens must be lexed from scratch */
+int tokbuf_relex(TOKBUF *tokens, TAPE *tape, size_t offset, size_t removed,
+                 char const *text, size_t inserted)
+{
+  size_t first, last, lo, hi, mid, at, n, tail, i;
+  size_t edited = offset + inserted; // end of the edit in the new text
+  long delta = (long) inserted - (long) removed;
+  TOKBUF *fresh = calloc(1, sizeof *fresh);
+  int token;
+
+  if (fresh == NULL || !tape_edit(tape, offset, removed, text, inserted)) {
+    free(fresh);
+    return -1;
+  }
+  tokens->source = tape->head;
+
+  // first: the first token that may change (LOOKAHEAD, see lexer.h), EOF at the latest
+  for (lo = 0, hi = tokens->count - 1; lo < hi; ) {
+    mid = lo + (hi - lo) / 2;
+    if (tokbuf_offset(tokens, mid) + tokens->length[mid] + LOOKAHEAD <= offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  first = lo;
+  tape->cursor = tape->head;
+  if (first > 0)
+    tape->cursor += tokbuf_offset(tokens, first - 1) + tokens->length[first - 1];
+
+  for (;;) {
+    token = lex_next(tape);
+    at = tape->token - tape->head;
+    if (at >= edited && token != UNTERMINATED
+        && (last = old_token(tokens, first, at - delta)) < tokens->count)
+      break;
+    if (!tokbuf_push(fresh, tape, token)) {
+      tokbuf_free(fresh);
+      return -1;
+    }
+    if (token == EOF) { // the old tokens end in an UNTERMINATED comment the edit closed
+      last = tokens->count;
+      break;
+    }
+  }
+
+  // splice: tokens[0, first) + fresh + tokens[last, count) shifted by delta
+  n = fresh->count;
+  tail = tokens->count - last;
+  if (first + n + tail > tokens->capacity && !tokbuf_grow(tokens, first + n + tail)) {
+    tokbuf_free(fresh);
+    return -1;
+  }
+  /* the pending shift moves to last: the tokens before first get their
+  true offsets, and those from last on all lack the same shift */
+  for (i = tokens->shifted; i < first; i++)
+    tokens->offset[i] += tokens->shift;
+  for (i = last; i < tokens->shifted && i < tokens->count; i++)
+    tokens->offset[i] -= tokens->shift;
+  MOVE(kind, first + n, last, tail);
+  MOVE(offset, first + n, last, tail);
+  MOVE(length, first + n, last, tail);
+  MOVE(value, first + n, last, tail);
+  COPY(kind, first, fresh, n);
+  COPY(offset, first, fresh, n);
+  COPY(length, first, fresh, n);
+  COPY(value, first, fresh, n);
+  tokens->count = first + n + tail;
+  tokens->shifted = first + n;
+  tokens->shift += delta;
+
+  /* an UNTERMINATED comment kept from before knows the line it opens at,
+  which the edit may have moved: it is lexed again from the token before */
+  i = tokens->count - 2;
+  if (tokens->count >= 2 && i >= first + n && tokens->kind[i] == UNTERMINATED) {
+    tape->cursor = tape->head + (i > 0 ? tokbuf_offset(tokens, i - 1) + tokens->length[i - 1] : 0);
+    lex_next(tape);
+    tokens->value[i] = lexval;
+  }
+
+  tokbuf_free(fresh);
+  tokens->next = tokens->current = 0;
+  tape->cursor = tape->token = tape->tail;
+  return n;
+}
+
+/* kind 0 stands for EOF, which does not fit the unsigned column */
+#define KIND(tokens, i) ((tokens)->kind[i] ? (tokens)->kind[i] : EOF)
+
+// tokbuf_advance: returns the next token and leaves its text in lexeme (but for names),
+// its value in lexval
+int tokbuf_advance(TOKBUF *tokens)
+{
+  size_t i = tokens->next, length = tokens->length[i];
+
+  tokens->current = i;
+  if (i + 1 < tokens->count)
+    tokens->next++;
+  lexval = tokens->value[i];
+  if (tokens->kind[i] == ID || tokens->kind[i] >= BEGIN)
+    return tokens->kind[i];
+  if (length > LEXEME_SIZE)
+    length = LEXEME_SIZE;
+  memcpy(lexeme, tokens->source + tokbuf_offset(tokens, i), length);
+  lexeme[length] = 0;
+  return KIND(tokens, i);
+}
+
+// tokbuf_peek: the token k positions after the one tokbuf_advance returns next
+int tokbuf_peek(TOKBUF const *tokens, size_t k)
+{
+  size_t i = tokens->next + k;
+
+  return KIND(tokens, i < tokens->count ? i : tokens->count - 1);
+}
+
+void tokbuf_free(TOKBUF *tokens)
+{
+  if (tokens == NULL)
+    return;
+  free(tokens->kind);
+  free(tokens->offset);
+  free(tokens->length);
+  free(tokens->value);
+  free(tokens);
+}
+
+void tokring_init(TOKRING *ring, TAPE *tape)
+{
+  ring->tape = tape;
+  ring->first = ring->count = 0;
+  ring->offset = 0;
+}
+
+// tokring_advance: same contract as tokbuf_advance, from the ring first, then the tape
+int tokring_advance(TOKRING *ring)
+{
+  TOKSLOT *slot;
+  int token;
+
+  if (ring->count == 0) {
+    token = gettoken(ring->tape);
+    ring->offset = ring->tape->base + (ring->tape->token - ring->tape->head);
+    return token;
+  }
+  slot = &ring->slot[ring->first];
+  ring->first = (ring->first + 1) & (TOKRING_SIZE - 1);
+  ring->count--;
+  lexval = slot->value;
+  strcpy(lexeme, slot->lexeme);
+  ring->offset = slot->offset;
+  return slot->kind;
+}
+
+/* tokring_peek: the token k positions after the one tokring_advance returns
+next, or 0 (no token) when k >= TOKRING_SIZE is out of the ring's reach.
+lexeme and lexval still describe the token the parser is on when it returns */
+int tokring_peek(TOKRING *ring, unsigned k)
+{
+  LEXVAL value = lexval;
+  char text[LEXEME_SIZE + 1];
+  TOKSLOT *slot;
+
+  if (k >= TOKRING_SIZE)
+    return 0;
+  if (ring->count <= k)
+    strcpy(text, lexeme);
+  while (ring->count <= k) {
+    slot = &ring->slot[(ring->first + ring->count++) & (TOKRING_SIZE - 1)];
+    lexval = (LEXVAL) {0};
+    slot->kind = gettoken(ring->tape);
+    slot->value = lexval;
+    slot->offset = ring->tape->base + (ring->tape->token - ring->tape->head);
+    strcpy(slot->lexeme, lexeme);
+    lexval = value;
+    strcpy(lexeme, text);
+  }
+  return ring->slot[(ring->first + k) & (TOKRING_SIZE - 1)].kind;
+}
@@ -0,0 +1,67 @@
+/**@<tokbuf.h>::**/
+#ifndef _TOKBUF_H_
+#define _TOKBUF_H_
+
+#include <stdint.h>
+#include <tape.h>
+#include <lexer.h>
+
+/*
+ * whole-file token buffer: the tape is lexed up front into parallel
+ * arrays (struct of arrays), so the parser walks them sequentially and can
+ * look any number of tokens ahead. The last token is always EOF.
+ *
+ * tokbuf_relex shifts the tokens behind an edit lazily: the offset of
+ * token i is offset[i] + shift once i >= shifted, and is read through
+ * tokbuf_offset. The next edit moves that boundary to itself, touching
+ * only the tokens between the two edits.
+ */
+typedef struct {
+  uint16_t *kind;      // token code, as returned by gettoken
+  uint32_t *offset;    // first byte of the token in the tape, before shift
+  uint32_t *length;    // bytes of source the token spans
+  LEXVAL *value;       // what lexval held for the token: ID name, literal value
+  size_t count;        // tokens in the buffer, EOF included
+  size_t capacity;     // slots allocated in each array
+  size_t next;         // index of the token tokbuf_advance returns next
+  size_t current;      // index of the token tokbuf_advance returned last
+  unsigned char const *source; // head of the tape the offsets refer to
+  size_t shifted;      // first token whose offset still lacks shift
+  long shift;          // bytes the tokens from shifted on have moved by
+} TOKBUF;
+
+extern TOKBUF *tokbuf_lex(TAPE *);
+extern TOKBUF *tokbuf_lex_parallel(TAPE *, int nthreads);
+extern int tokbuf_relex(TOKBUF *, TAPE *, size_t offset, size_t removed,
+                        char const *text, size_t inserted);
+extern int tokbuf_advance(TOKBUF *);
+extern int tokbuf_peek(TOKBUF const *, size_t k);
+extern size_t tokbuf_offset(TOKBUF const *, size_t i);
+extern void tokbuf_free(TOKBUF *);
+
+/*
+ * lookahead ring: when the tape is lexed on demand, tokens the parser peeks
+ * at are lexed into a small ring and handed out from there when it gets to
+ * them, so peeking never rereads source and no character is ever pushed back
+ */
+#define TOKRING_SIZE 8 // a power of two; peek reaches TOKRING_SIZE - 1 tokens ahead, gives 0 past that
+
+typedef struct {
+  int kind;
+  LEXVAL value;
+  size_t offset;                  // in the source, base of a streamed tape included
+  char lexeme[LEXEME_SIZE + 1];   // as gettoken left it (but for names)
+} TOKSLOT;
+
+typedef struct {
+  TAPE *tape;
+  TOKSLOT slot[TOKRING_SIZE];
+  unsigned first, count;          // slot of the next token, tokens in the ring
+  size_t offset;                  // of the token tokring_advance returned last
+} TOKRING;
+
+extern void tokring_init(TOKRING *, TAPE *);
+extern int tokring_advance(TOKRING *);
+extern int tokring_peek(TOKRING *, unsigned k);
+
+#endif
@@ -9,6 +9,8 @@ enum {
 	GEQ,
 	LEQ,
 	NEQ,
+	RANGE,
+	UNTERMINATED, // a comment never closed, opening at lexval.opening
 };
 
 enum {